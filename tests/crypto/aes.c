@@ -0,0 +1,95 @@
+/*
+ * AES-128-CTR backends: computed S-box (size build), T-table and AES-NI
+ * (SPEED=1), bitsliced (AES_CT=1). FIPS-197 and SP 800-38A vectors, and a
+ * seeded random run of keys, counters (some about to carry across 64 bits)
+ * and lengths that tests/test_crypto.sh compares between them.
+ *
+ * Built with -DKAT_AES_NI=0 the speed build takes the T-table (or, with
+ * AES_CT, the bitsliced kernel) even on a CPU with AES-NI; with 1 it must
+ * find AES-NI.
+ */
+#include "kat.h"
+#include "aes128_minimal.h"
+
+#define RUNS 300
+#ifndef KAT_AES_NI
+#define KAT_AES_NI 1
+#endif
+
+static uint8_t buf[2048];
+
+/* One shot of n bytes of zeros: the raw keystream */
+static void ctr(const char *key, const char *iv, size_t n) {
+    uint8_t k[16], c[16];
+    aes128_ctr_ctx x;
+    kat_unhex(k, key, 16);
+    kat_unhex(c, iv, 16);
+    aes128_ctr_init(&x, k, c);
+    memset(buf, 0, n);
+    aes128_ctr_crypt(&x, buf, n);
+}
+
+int main(void) {
+#ifdef NANO_SPEED
+    aes_gentables();
+#endif
+#ifdef AES128_NI
+    if (!KAT_AES_NI) aes_ni = 0;
+    else if (!aes_ni) {
+        kat_puts("FAIL aes-ni: the CPU has none\n");
+        return 1;
+    }
+#endif
+
+    /* FIPS-197 C.1: one block, the counter being the plaintext */
+    ctr("000102030405060708090a0b0c0d0e0f",
+        "00112233445566778899aabbccddeeff", 16);
+    kat("fips-197 c.1", buf, "69c4e0d86a7b0430d8cdb78070b4c55a");
+
+    /* SP 800-38A F.5.1 CTR-AES128.Encrypt, all four blocks at once and
+     * (continuing the counter) block by block */
+    static const char *pt =
+        "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+        "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+    static const char *ct =
+        "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff"
+        "5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee";
+    uint8_t k[16], c[16], p[64];
+    aes128_ctr_ctx x;
+    kat_unhex(k, "2b7e151628aed2a6abf7158809cf4f3c", 16);
+    kat_unhex(c, "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff", 16);
+    kat_unhex(p, pt, 64);
+    aes128_ctr_init(&x, k, c);
+    aes128_ctr_crypt(&x, p, 64);
+    kat("sp800-38a f.5.1", p, ct);
+    kat_unhex(p, pt, 64);
+    aes128_ctr_init(&x, k, c);
+    for (int i = 0; i < 4; i++) aes128_ctr_crypt(&x, p + 16 * i, 16);
+    kat("sp800-38a f.5.1 by block", p, ct);
+
+    /* A counter the caller sets between calls (as UMAC does) is used as
+     * set, whatever keystream an earlier short call made ahead */
+    aes128_ctr_init(&x, k, c);
+    aes128_ctr_crypt(&x, buf, 16);
+    kat_unhex(p, pt, 64);
+    memcpy(x.counter, c, 16);
+    aes128_ctr_crypt(&x, p, 64);
+    kat("sp800-38a f.5.1 counter reset", p, ct);
+
+    /* Random run: every call continues the counter, a partial block
+     * consuming a whole one; long calls take the 8-block paths */
+    for (int i = 0; i < RUNS; i++) {
+        kat_rand_bytes(k, 16);
+        kat_rand_bytes(c, 16);
+        if (i % 4 == 0) memset(c + 8, 0xff, 8 - (i / 4) % 3);
+        aes128_ctr_init(&x, k, c);
+        for (int j = 0; j < 3; j++) {
+            size_t n = kat_rand() % (i % 8 ? 300 : sizeof(buf));
+            kat_rand_bytes(buf, n);
+            aes128_ctr_crypt(&x, buf, n);
+            kat_line("ctr", buf, n);
+        }
+        kat_line("counter", x.counter, 16);
+    }
+    return kat_fails != 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * ChaCha20 DRBG of the speed build (random_minimal.h): the RFC 8439 A.1
+ * block vectors, and randombytes_buf() run from a known key to check the
+ * fast key erasure: the first 32 bytes of a refill become the next key,
+ * the rest is served in order, and nothing served or keyed stays behind.
+ */
+#include "kat.h"
+#include "random_minimal.h"
+
+static void block(const char *name, const char *key, uint32_t ctr,
+                  const char *want) {
+    uint8_t k[32], b[64];
+    uint32_t w[8];
+    kat_unhex(k, key, 32);
+    memcpy(w, k, sizeof(w));            /* little-endian words */
+    chacha20_block(b, w, ctr);
+    kat(name, b, want);
+}
+
+static const char *zero =
+    "0000000000000000000000000000000000000000000000000000000000000000";
+
+int main(void) {
+    /* RFC 8439 A.1 test vectors 1-4 (the nonce is 0 in all of them) */
+    block("chacha20 a.1 #1", zero, 0,
+          "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+          "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586");
+    block("chacha20 a.1 #2", zero, 1,
+          "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+          "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f");
+    block("chacha20 a.1 #3",
+          "0000000000000000000000000000000000000000000000000000000000000001", 1,
+          "3aeb5224ecf849929b9d828db1ced4dd832025e8018b8160b82284f3c949aa5a"
+          "8eca00bbb4a73bdad192b5c42f73f2fd4e273644c8b36125a64addeb006c13a0");
+    block("chacha20 a.1 #4",
+          "00ff000000000000000000000000000000000000000000000000000000000000", 2,
+          "72d54dfbf12ec44b362692df94137f328fea8da73990265ec1bbbea1ae9af0ca"
+          "13b25aa26cb4a648cb9b9d1be65b2c0924a66c54d545ec1b7374f4872e99f096");
+
+    /* DRBG: a seeded state with the zero key and an empty buffer, so the
+     * next refill runs blocks 0-15 of vectors #1/#2 without reseeding */
+    static rng_state st;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    st.seeded = 1;
+    st.pos = RNG_BUF;
+    st.seed_time = ts.tv_sec;
+    rng = &st;
+
+    uint8_t b[64];
+    randombytes_buf(b, 32);
+    kat("drbg serves block 0 after the key", b,
+        "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586");
+    kat("drbg next key is block 0 head", (const uint8_t *)st.key,
+        "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7");
+    randombytes_buf(b, 64);
+    kat("drbg continues into block 1", b,
+        "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+        "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f");
+    kat("drbg wiped the key and served bytes", st.buf,
+        "0000000000000000000000000000000000000000000000000000000000000000"
+        "0000000000000000000000000000000000000000000000000000000000000000"
+        "0000000000000000000000000000000000000000000000000000000000000000"
+        "0000000000000000000000000000000000000000000000000000000000000000");
+
+    /* Draining the buffer refills under the new key: block 0 of that */
+    uint8_t k[32], want[64];
+    memcpy(k, st.key, sizeof(k));
+    chacha20_block(want, st.key, 0);
+    while (st.pos < RNG_BUF) randombytes_buf(b, 1);
+    randombytes_buf(b, 32);
+    if (!memcmp(b, want + 32, 32) && memcmp(st.key, k, sizeof(k)) &&
+        !memcmp(st.key, want, sizeof(k))) {
+        kat_puts("ok drbg refill re-keys\n");
+    } else {
+        kat_fails++;
+        kat_puts("FAIL drbg refill re-keys: not served from the new key\n");
+    }
+    return kat_fails != 0;
+}
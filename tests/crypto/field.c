@@ -0,0 +1,103 @@
+/*
+ * GF(2^255-19) backends (FIELD=f25519, f25519_51): RFC 7748 X25519
+ * vectors, and a seeded random run over every f25519.h operation that
+ * tests/test_crypto.sh compares between the two.
+ */
+#include "kat.h"
+#include "f25519.h"
+#include "c25519.h"
+
+#define RUNS 2000
+
+/* Inputs as the callers produce them: below 2^255, so possibly >= p */
+static void rand_elem(uint8_t *x, int i) {
+    kat_rand_bytes(x, F25519_SIZE);
+    x[31] &= 0x7f;
+    switch (i % 16) {                   /* and the edges now and then */
+    case 0: memset(x, 0, F25519_SIZE); break;
+    case 1: memset(x, 0xff, F25519_SIZE); x[31] = 0x7f; break;  /* p + 18 */
+    case 2: memset(x, 0xff, F25519_SIZE); x[0] = 0xec; x[31] = 0x7f; break;  /* p - 1 */
+    case 3: memset(x, 0xff, F25519_SIZE); x[0] = 0xed; x[31] = 0x7f; break;  /* p */
+    }
+}
+
+static void put(const char *tag, const uint8_t *x) {
+    uint8_t n[F25519_SIZE];
+    f25519_copy(n, x);
+    f25519_normalize(n);
+    kat_line(tag, n, F25519_SIZE);
+}
+
+static void x25519(const char *name, const char *k, const char *u,
+                   const char *want) {
+    uint8_t e[32], q[32], r[32];
+    kat_unhex(e, k, 32);
+    kat_unhex(q, u, 32);
+    c25519_prepare(e);
+    c25519_smult(r, q, e);
+    kat(name, r, want);
+}
+
+int main(void) {
+    /* RFC 7748 5.2, and the public keys and shared secret of 6.1 */
+    x25519("x25519 5.2",
+           "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4",
+           "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c",
+           "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552");
+    x25519("x25519 5.2 k=u=9",
+           "0900000000000000000000000000000000000000000000000000000000000000",
+           "0900000000000000000000000000000000000000000000000000000000000000",
+           "422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079");
+    x25519("x25519 6.1 alice",
+           "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",
+           "0900000000000000000000000000000000000000000000000000000000000000",
+           "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a");
+    x25519("x25519 6.1 bob",
+           "5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb",
+           "0900000000000000000000000000000000000000000000000000000000000000",
+           "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f");
+    x25519("x25519 6.1 shared",
+           "77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a",
+           "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f",
+           "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+
+    /* Random run. acc is never normalized in between, so every operation
+     * also sees the un-normalized values the curve code feeds it. */
+    uint8_t a[32], b[32], r[32], s[32], acc[32];
+    f25519_load(acc, 1);
+    for (int i = 0; i < RUNS; i++) {
+        rand_elem(a, i);
+        rand_elem(b, i / 16 + 5);
+        uint32_t c = (uint32_t)kat_rand() & 0xffffff;
+
+        f25519_add(r, a, b); put("add", r);
+        f25519_sub(r, a, b); put("sub", r);
+        f25519_neg(r, a); put("neg", r);
+        f25519_mul__distinct(r, a, b); put("mul", r);
+        f25519_mul_c(r, a, c); put("mul_c", r);
+        f25519_select(r, a, b, (uint8_t)(c & 1)); put("select", r);
+        f25519_sub(r, a, b);
+        f25519_add(s, r, b);            /* (a - b) + b */
+        f25519_normalize(s);
+        f25519_copy(r, a);
+        f25519_normalize(r);
+        r[0] = f25519_eq(r, s);
+        kat_line("eq", r, 1);
+
+        f25519_mul__distinct(s, acc, a);
+        f25519_add(acc, s, b);
+        f25519_sub(s, acc, a);
+        f25519_mul_c(acc, s, c | 1);
+        put("acc", acc);
+
+        if (i % 16 == 4) {
+            f25519_inv__distinct(r, a); put("inv", r);
+            f25519_mul__distinct(s, a, a);
+            f25519_sqrt(r, s);          /* of a square: +-a */
+            put("sqrt", r);
+            f25519_mul__distinct(b, r, r);
+            put("sqrt^2", b);
+        }
+    }
+    return kat_fails != 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Shared by the tests/crypto harnesses. Each is built freestanding against
+ * one version's sources (its nolibc.c supplies _start), once per backend
+ * build, by tests/test_crypto.sh.
+ *
+ * A harness prints "ok <name>" or "FAIL <name>: ..." per known-answer
+ * test and exits non-zero if any failed. Lines starting with "=" are
+ * results of a seeded random run: the same harness built against another
+ * backend must print them identically, which the script checks.
+ */
+#ifndef KAT_H
+#define KAT_H
+
+#include <stdint.h>
+#include "nolibc.h"
+
+static int kat_fails;
+
+static void kat_puts(const char *s) {
+    write(1, s, strlen(s));
+}
+
+static void kat_hex(const uint8_t *b, size_t n) {
+    static const char x[] = "0123456789abcdef";
+    char o[2];
+    for (size_t i = 0; i < n; i++) {
+        o[0] = x[b[i] >> 4]; o[1] = x[b[i] & 15];
+        write(1, o, 2);
+    }
+}
+
+/* "=<tag> <hex>": one result of the random run */
+static void kat_line(const char *tag, const uint8_t *b, size_t n) {
+    kat_puts("=");
+    kat_puts(tag);
+    kat_puts(" ");
+    kat_hex(b, n);
+    kat_puts("\n");
+}
+
+/* n bytes from hex (no separators) */
+static void kat_unhex(uint8_t *b, const char *h, size_t n) {
+    for (size_t i = 0; i < 2 * n; i++) {
+        char c = h[i];
+        uint8_t v = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+        b[i / 2] = i & 1 ? b[i / 2] | v : v << 4;
+    }
+}
+
+/* Compare n bytes against the expected hex */
+static void kat(const char *name, const uint8_t *got, const char *want) {
+    uint8_t w[256];
+    size_t n = strlen(want) / 2;
+    kat_unhex(w, want, n);
+    if (!memcmp(got, w, n)) {
+        kat_puts("ok ");
+        kat_puts(name);
+        kat_puts("\n");
+        return;
+    }
+    kat_fails++;
+    kat_puts("FAIL ");
+    kat_puts(name);
+    kat_puts(": got ");
+    kat_hex(got, n);
+    kat_puts(", want ");
+    kat_puts(want);
+    kat_puts("\n");
+}
+
+/* xorshift64*: the same stream for every build */
+static uint64_t kat_seed = 0x9e3779b97f4a7c15ull;
+
+static uint64_t kat_rand(void) {
+    kat_seed ^= kat_seed >> 12;
+    kat_seed ^= kat_seed << 25;
+    kat_seed ^= kat_seed >> 27;
+    return kat_seed * 0x2545f4914f6cdd1dull;
+}
+
+static void kat_rand_bytes(uint8_t *b, size_t n) {
+    for (size_t i = 0; i < n; i++) b[i] = (uint8_t)(kat_rand() >> 56);
+}
+
+#endif /* KAT_H */
@@ -0,0 +1,94 @@
+/*
+ * SHA-256 backends: the size build's rolled rounds, the speed build's
+ * unrolled block-oriented ones, AVX2 and SHA-NI. FIPS 180-2 and RFC 4231
+ * vectors, and a seeded random run of messages hashed both in one update
+ * and in random pieces (which must agree) that tests/test_crypto.sh
+ * compares between them.
+ *
+ * -DKAT_SHA_HW=n overrides the backend sha_gentables() picked from CPUID
+ * (0: portable, SHA256_HW_AVX2, SHA256_HW_NI), so one CPU can run each in
+ * turn.
+ */
+#include "kat.h"
+#include "sha256_minimal.h"
+
+#define RUNS 400
+
+static uint8_t msg[4096];
+
+static void hash(const char *name, const uint8_t *m, uint32_t n,
+                 uint32_t reps, const char *want) {
+    sha256_ctx c;
+    uint8_t d[32];
+    sha256_init(&c);
+    while (reps--) sha256_update(&c, m, n);
+    sha256_final(&c, d);
+    kat(name, d, want);
+}
+
+static void hmac(const char *name, const uint8_t *k, uint32_t kl,
+                 const char *m, const char *want) {
+    hmac_sha256_ctx c;
+    uint8_t d[32];
+    hmac_sha256_init(&c, k, kl);
+    hmac_sha256_update(&c, (const uint8_t *)m, strlen(m));
+    hmac_sha256_final(&c, d);
+    kat(name, d, want);
+}
+
+int main(void) {
+    sha_gentables();
+#ifdef KAT_SHA_HW
+    sha256_hw = KAT_SHA_HW;
+#endif
+
+    /* FIPS 180-2 appendix B, and the empty message */
+    hash("sha256 empty", msg, 0, 1,
+         "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    hash("sha256 abc", (const uint8_t *)"abc", 3, 1,
+         "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    hash("sha256 448 bits",
+         (const uint8_t *)"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+         56, 1,
+         "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    memset(msg, 'a', 1000);
+    hash("sha256 a x 1000000", msg, 1000, 1000,
+         "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    /* RFC 4231 test cases 1 and 2 */
+    memset(msg, 0x0b, 20);
+    hmac("hmac-sha256 rfc4231 1", msg, 20, "Hi There",
+         "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+    hmac("hmac-sha256 rfc4231 2", (const uint8_t *)"Jefe", 4,
+         "what do ya want for nothing?",
+         "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+    /* Random run */
+    int split = 0;
+    for (int i = 0; i < RUNS; i++) {
+        uint32_t n = (uint32_t)(kat_rand() % (i % 8 ? 300 : sizeof(msg)));
+        sha256_ctx c;
+        uint8_t one[32], parts[32];
+        kat_rand_bytes(msg, n);
+        sha256_init(&c);
+        sha256_update(&c, msg, n);
+        sha256_final(&c, one);
+        kat_line("sha256", one, 32);
+
+        sha256_init(&c);
+        for (uint32_t o = 0, l; o < n; o += l) {
+            l = (uint32_t)(kat_rand() % 150);
+            if (l > n - o) l = n - o;
+            sha256_update(&c, msg + o, l);
+        }
+        sha256_final(&c, parts);
+        split += memcmp(one, parts, 32) != 0;
+    }
+    if (split) {
+        kat_fails++;
+        kat_puts("FAIL sha256 in pieces: differs from one update\n");
+    } else {
+        kat_puts("ok sha256 in pieces\n");
+    }
+    return kat_fails != 0;
+}
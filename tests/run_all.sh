@@ -41,6 +41,16 @@ cd "$(dirname "$0")/.."
 run_test "tests/test_version.sh" "Version Exchange"
 run_test "tests/test_connection.sh" "Full SSH Connection"
 run_test "tests/test_auth.sh" "Authentication"
+run_test "tests/test_disconnect.sh" "Abrupt Disconnects"
+run_test "tests/test_fdlimit.sh" "Out of File Descriptors"
+run_test "tests/test_exec.sh" "Exec Channels"
+run_test "tests/test_channels.sh" "Many Channels"
+run_test "tests/test_sftp.sh" "SFTP Subsystem"
+run_test "tests/test_compression.sh" "Compression"
+run_test "tests/test_macs.sh" "MAC Algorithms"
+run_test "tests/test_rekey.sh" "Key Re-exchange"
+run_test "tests/test_forward.sh" "direct-tcpip Forwarding"
+run_test "tests/test_crypto.sh" "Crypto Backends"
 
 # Print summary
 echo ""
@@ -0,0 +1,114 @@
+#!/usr/bin/env bash
+# Test: many channels on one connection
+# Verifies, through an OpenSSH ControlMaster, that sessions run side by
+# side on one connection, that data on one does not stall the others and
+# that channel slots are reused once closed
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+PORT=2222
+TIMEOUT=60
+PARALLEL=10                             # SSH_MAX_CHAN
+
+echo "========================================"
+echo "Test: Many Channels"
+echo "Version: $VERSION"
+echo "========================================"
+
+# Check if binary exists
+if [ ! -f "$VERSION/nano_ssh_server" ]; then
+    echo "ERROR: $VERSION/nano_ssh_server not found"
+    echo "Run 'just build $VERSION' first"
+    exit 1
+fi
+
+# The password comes from SSH_ASKPASS: sshpass would not pass stdin on
+WORK=$(mktemp -d)
+printf '#!/bin/sh\necho password123\n' > $WORK/askpass
+chmod +x $WORK/askpass
+export SSH_ASKPASS=$WORK/askpass SSH_ASKPASS_REQUIRE=force DISPLAY=:0
+SSH_OPTS="-F none -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR -o NumberOfPasswordPrompts=1 -p $PORT"
+SSH_OPTS="$SSH_OPTS -o ControlMaster=auto -o ControlPath=$WORK/cm -o ControlPersist=60"
+
+pkill -x nano_ssh_server || true
+sleep 1
+
+echo "Starting server..."
+cd $VERSION
+./nano_ssh_server > test_channels.log 2>&1 &
+SERVER_PID=$!
+cd ..
+sleep 2
+
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    echo "ERROR: Server failed to start"
+    cat $VERSION/test_channels.log
+    rm -rf $WORK
+    exit 1
+fi
+
+FAILED=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "✓ $1"
+    else
+        echo "✗ $1: got '$2', want '$3'"
+        FAILED=1
+    fi
+}
+run() {
+    timeout $TIMEOUT ssh $SSH_OPTS user@localhost "$@"
+}
+
+run true < /dev/null                    # the master
+FDS_BEFORE=$(ls /proc/$SERVER_PID/fd | wc -l)
+
+PIDS=
+for i in $(seq $PARALLEL); do
+    run "sleep 1; echo ch$i" < /dev/null > $WORK/par.$i 2>&1 &
+    PIDS="$PIDS $!"
+done
+wait $PIDS 2>/dev/null || true
+check "$PARALLEL sessions at once" "$(cat $WORK/par.* | sort -V | tr '\n' ' ')" \
+    "$(seq -f 'ch%g' $PARALLEL | tr '\n' ' ')"
+
+# a download and an upload in flight while another session comes and goes
+head -c 40000 /dev/urandom > $WORK/up.bin
+run 'head -c 40000 /dev/zero' < /dev/null | wc -c > $WORK/down.out &
+DOWN=$!
+run 'cat' < $WORK/up.bin | sha256sum | cut -d' ' -f1 > $WORK/up.out &
+UP=$!
+sleep 0.5
+check "session beside two transfers" "$(run 'echo beside' < /dev/null)" "beside"
+wait $DOWN $UP 2>/dev/null || true
+check "download beside an upload" "$(tr -d ' ' < $WORK/down.out)" "40000"
+check "upload beside a download" "$(cat $WORK/up.out)" \
+    "$(sha256sum < $WORK/up.bin | cut -d' ' -f1)"
+
+# more sessions than slots, one after the other
+N=0
+for i in $(seq 3 $PARALLEL); do
+    [ "$(run "echo $i" < /dev/null)" = "$i" ] && N=$((N + 1))
+done
+for i in $(seq 3 $PARALLEL); do
+    [ "$(run "echo $i" < /dev/null)" = "$i" ] && N=$((N + 1))
+done
+check "slots reused" "$N" "$((2 * (PARALLEL - 2)))"
+
+FDS_AFTER=$(ls /proc/$SERVER_PID/fd | wc -l)
+check "no fds left behind" "$FDS_AFTER" "$FDS_BEFORE"
+
+ssh $SSH_OPTS -O exit user@localhost 2>/dev/null || true
+kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
+rm -rf $WORK
+
+if [ $FAILED -eq 0 ]; then
+    echo "✓ PASS: Channels share the connection"
+    exit 0
+else
+    echo "✗ FAIL: Channels misbehaved"
+    cat $VERSION/test_channels.log
+    exit 1
+fi
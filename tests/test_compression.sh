@@ -0,0 +1,92 @@
+#!/usr/bin/env bash
+# Test: zlib@openssh.com compression (ssh -C)
+# Verifies that compression is negotiated, that data round-trips intact
+# both ways, and that it actually shrinks on the wire
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+PORT=2222
+TIMEOUT=60
+LINES=20000
+
+echo "========================================"
+echo "Test: Compression"
+echo "Version: $VERSION"
+echo "========================================"
+
+# Check if binary exists
+if [ ! -f "$VERSION/nano_ssh_server" ]; then
+    echo "ERROR: $VERSION/nano_ssh_server not found"
+    echo "Run 'just build $VERSION' first"
+    exit 1
+fi
+
+# The password comes from SSH_ASKPASS: sshpass would not pass stdin on
+WORK=$(mktemp -d)
+printf '#!/bin/sh\necho password123\n' > $WORK/askpass
+chmod +x $WORK/askpass
+export SSH_ASKPASS=$WORK/askpass SSH_ASKPASS_REQUIRE=force DISPLAY=:0
+SSH_OPTS="-F none -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR -o NumberOfPasswordPrompts=1 -p $PORT -C -v"
+
+pkill -x nano_ssh_server || true
+sleep 1
+
+echo "Starting server..."
+cd $VERSION
+./nano_ssh_server > test_compression.log 2>&1 &
+SERVER_PID=$!
+cd ..
+sleep 2
+
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    echo "ERROR: Server failed to start"
+    cat $VERSION/test_compression.log
+    rm -rf $WORK
+    exit 1
+fi
+
+FAILED=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "✓ $1"
+    else
+        echo "✗ $1: got '$2', want '$3'"
+        FAILED=1
+    fi
+}
+# "compress incoming: raw data R, compressed C, factor F" from ssh -v:
+# 1 if C < R
+shrunk() {
+    grep "compress $1:" $2 |
+        awk -F'[ ,]+' '{ for (i = 1; i < NF; i++) { if ($i == "raw") r = $(i + 2);
+                        if ($i == "compressed") c = $(i + 1) } }
+                        END { print (c > 0 && c < r) ? 1 : 0 }'
+}
+
+WANT=$(seq 1 $LINES | sha256sum | cut -d' ' -f1)
+
+GOT=$(timeout $TIMEOUT ssh $SSH_OPTS user@localhost "seq 1 $LINES" \
+    < /dev/null 2>$WORK/down.log | sha256sum | cut -d' ' -f1)
+check "zlib@openssh.com negotiated" \
+    "$(grep -c 'compression: zlib@openssh.com' $WORK/down.log || true)" "2"
+check "download intact" "$GOT" "$WANT"
+check "download compressed" "$(shrunk incoming $WORK/down.log)" "1"
+
+GOT=$(seq 1 $LINES | timeout $TIMEOUT ssh $SSH_OPTS user@localhost 'sha256sum' \
+    2>$WORK/up.log | cut -d' ' -f1)
+check "upload intact" "$GOT" "$WANT"
+check "upload compressed" "$(shrunk outgoing $WORK/up.log)" "1"
+
+kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
+rm -rf $WORK
+
+if [ $FAILED -eq 0 ]; then
+    echo "✓ PASS: Compressed sessions round-trip"
+    exit 0
+else
+    echo "✗ FAIL: Compression misbehaved"
+    cat $VERSION/test_compression.log
+    exit 1
+fi
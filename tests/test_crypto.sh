@@ -0,0 +1,124 @@
+#!/usr/bin/env bash
+# Test: crypto backends
+# Builds each tests/crypto harness against the version's sources, once per
+# backend of its primitive, checks the known-answer tests of every build
+# and that all backends of a primitive agree on a seeded random run
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+CC=${CC:-gcc}
+# freestanding like the server; -fno-builtin keeps GCC from assuming libc
+CFLAGS="-std=c11 -O2 -Wall -Wextra -nostdlib -ffreestanding -static -fno-stack-protector -fno-builtin"
+
+echo "========================================"
+echo "Test: Crypto Backends"
+echo "Version: $VERSION"
+echo "========================================"
+
+if [ ! -f "$VERSION/nolibc.c" ]; then
+    echo "ERROR: $VERSION has no sources to build against"
+    exit 1
+fi
+
+WORK=$(mktemp -d)
+FAILED=0
+
+# harness TAG NAME "SOURCES" "FLAGS": build tests/crypto/NAME.c with the
+# version's SOURCES (nolibc.c is implied) and FLAGS, run it as TAG
+harness() {
+    local tag=$1 name=$2 srcs="" s
+    for s in $3 nolibc.c; do srcs="$srcs $VERSION/$s"; done
+    if ! $CC $CFLAGS $4 -I$VERSION tests/crypto/$name.c $srcs \
+            -o $WORK/$tag 2>$WORK/$tag.err; then
+        echo "✗ $tag: does not build"
+        cat $WORK/$tag.err
+        FAILED=1
+        return
+    fi
+    if $WORK/$tag > $WORK/$tag.out; then
+        echo "✓ $tag: $(grep -c '^ok ' $WORK/$tag.out) known answers"
+    else
+        echo "✗ $tag:"
+        grep '^FAIL' $WORK/$tag.out || true
+        FAILED=1
+    fi
+}
+
+# same TAG1 TAG2: both builds printed the same random-run results
+same() {
+    grep '^=' $WORK/$1.out > $WORK/$1.rand || true
+    grep '^=' $WORK/$2.out > $WORK/$2.rand || true
+    if [ -s $WORK/$1.rand ] && cmp -s $WORK/$1.rand $WORK/$2.rand; then
+        echo "✓ $1 = $2 ($(wc -l < $WORK/$1.rand) random results)"
+    else
+        echo "✗ $1 and $2 disagree:"
+        diff $WORK/$1.rand $WORK/$2.rand | head -4 || true
+        FAILED=1
+    fi
+}
+
+# GF(2^255-19): byte limbs (size build) and radix 2^51 (SPEED=1)
+harness field-f25519 field "f25519.c c25519.c" ""
+harness field-f25519_51 field "f25519_51.c c25519.c" ""
+same field-f25519 field-f25519_51
+
+# AES-128-CTR: computed S-box (size build), T-table and AES-NI (SPEED=1),
+# bitsliced (AES_CT=1, either build)
+harness aes-sbox aes "" ""
+harness aes-ttable aes "" "-DNANO_SPEED -DKAT_AES_NI=0"
+same aes-sbox aes-ttable
+harness aes-bitsliced aes "" "-DNANO_AES_CT"
+same aes-sbox aes-bitsliced
+harness aes-bitsliced-speed aes "" "-DNANO_AES_CT -DNANO_SPEED -DKAT_AES_NI=0"
+same aes-sbox aes-bitsliced-speed
+if grep -qw aes /proc/cpuinfo; then
+    harness aes-ni aes "" "-DNANO_SPEED -DKAT_AES_NI=1"
+    same aes-sbox aes-ni
+else
+    echo "- aes-ni: skipped, the CPU has no AES-NI"
+fi
+
+# SHA-256: rolled rounds (size build), unrolled blocks (SPEED=1, portable),
+# AVX2 and SHA-NI (SPEED=1, where the CPU has them)
+harness sha256-size sha256 "sha512.c" ""
+harness sha256-speed sha256 "sha512.c" "-DNANO_SPEED -DKAT_SHA_HW=0"
+same sha256-size sha256-speed
+if grep -qw avx2 /proc/cpuinfo && grep -qw bmi2 /proc/cpuinfo; then
+    harness sha256-avx2 sha256 "sha512.c" "-DNANO_SPEED -DKAT_SHA_HW=1"
+    same sha256-size sha256-avx2
+else
+    echo "- sha256-avx2: skipped, the CPU has no AVX2/BMI2"
+fi
+if grep -qw sha_ni /proc/cpuinfo; then
+    harness sha256-ni sha256 "sha512.c" "-DNANO_SPEED -DKAT_SHA_HW=2"
+    same sha256-size sha256-ni
+else
+    echo "- sha256-ni: skipped, the CPU has no SHA extensions"
+fi
+
+# UMAC: over each AES-128 backend it is built on
+harness umac-sbox umac "" ""
+harness umac-ttable umac "" "-DNANO_SPEED -DKAT_AES_NI=0"
+same umac-sbox umac-ttable
+harness umac-bitsliced umac "" "-DNANO_AES_CT"
+same umac-sbox umac-bitsliced
+if grep -qw aes /proc/cpuinfo; then
+    harness umac-aes-ni umac "" "-DNANO_SPEED -DKAT_AES_NI=1"
+    same umac-sbox umac-aes-ni
+else
+    echo "- umac-aes-ni: skipped, the CPU has no AES-NI"
+fi
+
+# ChaCha20 DRBG (SPEED=1; the size build calls getrandom() directly)
+harness chacha20-drbg chacha "" "-DNANO_SPEED"
+
+rm -rf $WORK
+
+if [ $FAILED -eq 0 ]; then
+    echo "✓ PASS: Crypto backends agree with the vectors and each other"
+    exit 0
+else
+    echo "✗ FAIL: A crypto backend is wrong"
+    exit 1
+fi
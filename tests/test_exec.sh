@@ -0,0 +1,98 @@
+#!/usr/bin/env bash
+# Test: exec channels
+# Verifies that a command gets the client's stdin, that stdout and stderr
+# stay apart, that its exit status or signal reaches the client, and that
+# requests the server does not honor are refused
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+PORT=2222
+TIMEOUT=30
+
+echo "========================================"
+echo "Test: Exec Channels"
+echo "Version: $VERSION"
+echo "========================================"
+
+# Check if binary exists
+if [ ! -f "$VERSION/nano_ssh_server" ]; then
+    echo "ERROR: $VERSION/nano_ssh_server not found"
+    echo "Run 'just build $VERSION' first"
+    exit 1
+fi
+
+# The password comes from SSH_ASKPASS: sshpass would not pass stdin on
+ASKPASS=$(mktemp)
+printf '#!/bin/sh\necho password123\n' > $ASKPASS
+chmod +x $ASKPASS
+export SSH_ASKPASS=$ASKPASS SSH_ASKPASS_REQUIRE=force DISPLAY=:0
+SSH_OPTS="-F none -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR -o NumberOfPasswordPrompts=1 -p $PORT"
+
+pkill -x nano_ssh_server || true
+sleep 1
+
+echo "Starting server..."
+cd $VERSION
+./nano_ssh_server > test_exec.log 2>&1 &
+SERVER_PID=$!
+cd ..
+sleep 2
+
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    echo "ERROR: Server failed to start"
+    cat $VERSION/test_exec.log
+    rm -f $ASKPASS
+    exit 1
+fi
+
+FAILED=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "✓ $1"
+    else
+        echo "✗ $1: got '$2', want '$3'"
+        FAILED=1
+    fi
+}
+run() {
+    timeout $TIMEOUT ssh $SSH_OPTS "$@"
+}
+
+GOT=$(printf 'one\ntwo\n' | run user@localhost 'wc -l' 2>/dev/null | tr -d ' ')
+check "stdin reaches the command" "$GOT" "2"
+
+ERR=$(mktemp)
+GOT=$(run user@localhost 'echo out; echo err >&2' < /dev/null 2>$ERR)
+check "stdout" "$GOT" "out"
+check "stderr" "$(cat $ERR)" "err"
+
+set +e
+run user@localhost 'exit 3' < /dev/null > /dev/null 2>&1
+check "exit-status" "$?" "3"
+set -e
+
+GOT=$(run -v user@localhost 'kill -TERM $$' < /dev/null 2>&1 |
+    grep -c "rtype exit-signal" || true)
+check "exit-signal on SIGTERM" "$GOT" "1"
+
+# pty-req is refused; with -tt the client gives up on the session
+GOT=$(run -tt user@localhost 'true' < /dev/null 2>&1 |
+    grep -c "PTY allocation request failed" || true)
+check "pty-req refused" "$GOT" "1"
+
+GOT=$(run user@localhost 'echo still here' < /dev/null 2>/dev/null)
+check "serves after the refusal" "$GOT" "still here"
+
+kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
+rm -f $ASKPASS $ERR
+
+if [ $FAILED -eq 0 ]; then
+    echo "✓ PASS: Exec channels behave"
+    exit 0
+else
+    echo "✗ FAIL: Exec channels misbehaved"
+    cat $VERSION/test_exec.log
+    exit 1
+fi
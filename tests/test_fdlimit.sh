@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+# Test: running out of fds
+# Verifies that a server at its fd limit leaves further clients queued
+# without spinning, and serves again once clients leave
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+PORT=2222
+TIMEOUT=30
+NOFILE=12                       # soft and hard: the server cannot lift it
+CLIENTS=15
+MAX_TICKS=30                    # CPU ticks (1/100 s) over 3 s: 10%
+
+echo "========================================"
+echo "Test: Out of File Descriptors"
+echo "Version: $VERSION"
+echo "========================================"
+
+# Check if binary exists
+if [ ! -f "$VERSION/nano_ssh_server" ]; then
+    echo "ERROR: $VERSION/nano_ssh_server not found"
+    echo "Run 'just build $VERSION' first"
+    exit 1
+fi
+
+pkill -x nano_ssh_server || true
+sleep 1
+
+echo "Starting server with $NOFILE fds..."
+cd $VERSION
+(ulimit -n $NOFILE; exec ./nano_ssh_server) > test_fdlimit.log 2>&1 &
+SERVER_PID=$!
+cd ..
+sleep 2
+
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    echo "ERROR: Server failed to start"
+    cat $VERSION/test_fdlimit.log
+    exit 1
+fi
+
+# Idle clients, more than the server has fds for
+PIDS=""
+for i in $(seq $CLIENTS); do
+    (exec 3<>/dev/tcp/127.0.0.1/$PORT; sleep 20) 2>/dev/null &
+    PIDS="$PIDS $!"
+done
+sleep 2
+
+ticks() { awk '{print $14 + $15}' /proc/$SERVER_PID/stat; }
+T0=$(ticks)
+sleep 3
+TICKS=$(( $(ticks) - T0 ))
+
+kill $PIDS 2>/dev/null || true
+wait $PIDS 2>/dev/null || true
+sleep 1
+
+OUTPUT=$(timeout $TIMEOUT sshpass -p password123 ssh -F none \
+    -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null \
+    -o LogLevel=ERROR -p $PORT user@localhost < /dev/null 2>&1 || true)
+
+kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
+
+if [ $TICKS -gt $MAX_TICKS ]; then
+    echo "✗ FAIL: Server used $TICKS CPU ticks in 3 s at its fd limit"
+    exit 1
+fi
+echo "✓ $TICKS CPU ticks in 3 s at the fd limit"
+if echo "$OUTPUT" | grep -q "Hello World"; then
+    echo "✓ PASS: Server waits out the fd limit and serves again"
+    exit 0
+else
+    echo "✗ FAIL: No 'Hello World' once the clients left"
+    echo "  Output: $OUTPUT"
+    exit 1
+fi
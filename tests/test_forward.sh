@@ -0,0 +1,102 @@
+#!/usr/bin/env bash
+# Test: direct-tcpip forwarding
+# Verifies that ssh -L relays to loopback services through the server and
+# that other addresses are refused (default build)
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+PORT=2222
+TIMEOUT=30
+HTTP_PORT=8765
+
+echo "========================================"
+echo "Test: direct-tcpip Forwarding"
+echo "Version: $VERSION"
+echo "========================================"
+
+# Check if binary exists
+if [ ! -f "$VERSION/nano_ssh_server" ]; then
+    echo "ERROR: $VERSION/nano_ssh_server not found"
+    echo "Run 'just build $VERSION' first"
+    exit 1
+fi
+
+ASKPASS=$(mktemp)
+printf '#!/bin/sh\necho password123\n' > $ASKPASS
+chmod +x $ASKPASS
+export SSH_ASKPASS=$ASKPASS SSH_ASKPASS_REQUIRE=force DISPLAY=:0
+SSH_OPTS="-F none -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR -o NumberOfPasswordPrompts=1 -p $PORT"
+
+pkill -x nano_ssh_server || true
+sleep 1
+
+echo "Starting server..."
+cd $VERSION
+./nano_ssh_server > test_forward.log 2>&1 &
+SERVER_PID=$!
+cd ..
+
+# Something to forward to: an HTTP server on every address. The size
+# build moves about 10 KB/s, so the file stays small
+WWW=$(mktemp -d)
+head -c 40000 /dev/urandom > $WWW/data.bin
+python3 -m http.server $HTTP_PORT --bind 0.0.0.0 --directory $WWW > /dev/null 2>&1 &
+HTTP_PID=$!
+sleep 2
+
+if ! kill -0 $SERVER_PID 2>/dev/null || ! kill -0 $HTTP_PID 2>/dev/null; then
+    echo "ERROR: Server or HTTP server (port $HTTP_PORT) failed to start"
+    cat $VERSION/test_forward.log
+    kill $SERVER_PID $HTTP_PID 2>/dev/null || true
+    rm -rf $ASKPASS $WWW
+    exit 1
+fi
+
+# A non-loopback address of this host, if it has one
+OTHER=$(hostname -I 2>/dev/null | tr ' ' '\n' | grep -m1 -E '^[0-9]+(\.[0-9]+){3}$' || true)
+
+ssh $SSH_OPTS -N -L 9001:127.0.0.1:$HTTP_PORT -L 9002:localhost:$HTTP_PORT \
+    -L 9003:127.0.0.1:1 ${OTHER:+-L 9004:$OTHER:$HTTP_PORT} user@localhost &
+SSH_PID=$!
+sleep 3
+
+WANT=$(sha256sum < $WWW/data.bin | cut -d' ' -f1)
+FAILED=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "✓ $1"
+    else
+        echo "✗ $1: got '${2:0:16}', want '${3:0:16}'"
+        FAILED=1
+    fi
+}
+
+GOT=$(curl -s -m $TIMEOUT http://127.0.0.1:9001/data.bin | sha256sum | cut -d' ' -f1)
+check "127.0.0.1 relays 40 KB" "$GOT" "$WANT"
+GOT=$(curl -s -m $TIMEOUT http://127.0.0.1:9002/data.bin | sha256sum | cut -d' ' -f1)
+check "localhost relays 40 KB" "$GOT" "$WANT"
+GOT=$(curl -s -m $TIMEOUT -o /dev/null -w '%{http_code}' http://127.0.0.1:9003/ || true)
+check "closed port is refused" "$GOT" "000"
+if [ -n "$OTHER" ]; then
+    GOT=$(curl -s -m $TIMEOUT -o /dev/null -w '%{http_code}' http://127.0.0.1:9004/ || true)
+    check "non-loopback $OTHER is refused" "$GOT" "000"
+fi
+# still usable after the refusals
+GOT=$(curl -s -m $TIMEOUT http://127.0.0.1:9001/data.bin | sha256sum | cut -d' ' -f1)
+check "relays again after refusals" "$GOT" "$WANT"
+
+kill $SSH_PID $HTTP_PID 2>/dev/null || true
+wait $SSH_PID $HTTP_PID 2>/dev/null || true
+kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
+rm -rf $ASKPASS $WWW
+
+if [ $FAILED -eq 0 ]; then
+    echo "✓ PASS: Forwarding reaches loopback only"
+    exit 0
+else
+    echo "✗ FAIL: Forwarding misbehaved"
+    cat $VERSION/test_forward.log
+    exit 1
+fi
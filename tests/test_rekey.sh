@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+# Test: key re-exchange
+# Verifies that data survives client-initiated rekeys in both directions,
+# with and without compression, including one right behind authentication
+# (where delayed compression switches on)
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+PORT=2222
+TIMEOUT=60
+LINES=10000
+
+echo "========================================"
+echo "Test: Key Re-exchange"
+echo "Version: $VERSION"
+echo "========================================"
+
+# Check if binary exists
+if [ ! -f "$VERSION/nano_ssh_server" ]; then
+    echo "ERROR: $VERSION/nano_ssh_server not found"
+    echo "Run 'just build $VERSION' first"
+    exit 1
+fi
+
+# The password comes from SSH_ASKPASS: sshpass would not pass stdin on
+ASKPASS=$(mktemp)
+printf '#!/bin/sh\necho password123\n' > $ASKPASS
+chmod +x $ASKPASS
+export SSH_ASKPASS=$ASKPASS SSH_ASKPASS_REQUIRE=force DISPLAY=:0
+SSH_OPTS="-F none -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR -o NumberOfPasswordPrompts=1 -p $PORT"
+
+pkill -x nano_ssh_server || true
+sleep 1
+
+echo "Starting server..."
+cd $VERSION
+./nano_ssh_server > test_rekey.log 2>&1 &
+SERVER_PID=$!
+cd ..
+sleep 2
+
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    echo "ERROR: Server failed to start"
+    cat $VERSION/test_rekey.log
+    rm -f $ASKPASS
+    exit 1
+fi
+
+WANT=$(seq 1 $LINES | sha256sum | cut -d' ' -f1)
+FAILED=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "✓ $1"
+    else
+        echo "✗ $1: got '${2:0:16}', want '${3:0:16}'"
+        FAILED=1
+    fi
+}
+
+for COMP in "" "-C"; do
+    # 1 KB: the client rekeys as soon as it is authenticated
+    OUT=$(timeout $TIMEOUT ssh $SSH_OPTS $COMP -o RekeyLimit=1K \
+        user@localhost < /dev/null 2>&1 || true)
+    check "session behind an immediate rekey ${COMP:-(no -C)}" \
+        "$(echo "$OUT" | grep -c "Hello World")" 1
+
+    GOT=$(timeout $TIMEOUT ssh $SSH_OPTS $COMP -o RekeyLimit=16K \
+        user@localhost "seq 1 $LINES" < /dev/null 2>/dev/null | sha256sum | cut -d' ' -f1)
+    check "download across rekeys ${COMP:-(no -C)}" "$GOT" "$WANT"
+
+    GOT=$(seq 1 $LINES | timeout $TIMEOUT ssh $SSH_OPTS $COMP -o RekeyLimit=16K \
+        user@localhost 'sha256sum' 2>/dev/null | cut -d' ' -f1)
+    check "upload across rekeys ${COMP:-(no -C)}" "$GOT" "$WANT"
+done
+
+kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
+rm -f $ASKPASS
+
+if [ $FAILED -eq 0 ]; then
+    echo "✓ PASS: Data intact across re-exchanges"
+    exit 0
+else
+    echo "✗ FAIL: Data lost or corrupted across a re-exchange"
+    cat $VERSION/test_rekey.log
+    exit 1
+fi
@@ -0,0 +1,90 @@
+#!/usr/bin/env bash
+# Test: sftp subsystem
+# Verifies put and get round-trip a file intact, and that the directory
+# operations sftp(1) uses (mkdir, ls, rename, rm, rmdir) work
+
+set -e
+
+VERSION=${1:-v0-vanilla}
+PORT=2222
+TIMEOUT=60
+
+echo "========================================"
+echo "Test: SFTP Subsystem"
+echo "Version: $VERSION"
+echo "========================================"
+
+# Check if binary exists
+if [ ! -f "$VERSION/nano_ssh_server" ]; then
+    echo "ERROR: $VERSION/nano_ssh_server not found"
+    echo "Run 'just build $VERSION' first"
+    exit 1
+fi
+
+# sftp(1) has no password option: the password comes from SSH_ASKPASS
+WORK=$(mktemp -d)
+printf '#!/bin/sh\necho password123\n' > $WORK/askpass
+chmod +x $WORK/askpass
+export SSH_ASKPASS=$WORK/askpass SSH_ASKPASS_REQUIRE=force DISPLAY=:0
+SFTP_OPTS="-F none -o StrictHostKeyChecking=no -o UserKnownHostsFile=/dev/null -o LogLevel=ERROR -o NumberOfPasswordPrompts=1 -P $PORT"
+
+pkill -x nano_ssh_server || true
+sleep 1
+
+echo "Starting server..."
+cd $VERSION
+./nano_ssh_server > test_sftp.log 2>&1 &
+SERVER_PID=$!
+cd ..
+sleep 2
+
+if ! kill -0 $SERVER_PID 2>/dev/null; then
+    echo "ERROR: Server failed to start"
+    cat $VERSION/test_sftp.log
+    rm -rf $WORK
+    exit 1
+fi
+
+FAILED=0
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "✓ $1"
+    else
+        echo "✗ $1: got '$2', want '$3'"
+        FAILED=1
+    fi
+}
+
+# The server shares this filesystem: $WORK/remote is the far side.
+# 100 KB spans several pipelined requests either way (32 KB each).
+head -c 100000 /dev/urandom > $WORK/local.bin
+WANT=$(sha256sum < $WORK/local.bin | cut -d' ' -f1)
+cat > $WORK/batch <<EOF
+mkdir $WORK/remote
+put $WORK/local.bin $WORK/remote/a.bin
+rename $WORK/remote/a.bin $WORK/remote/b.bin
+ls $WORK/remote
+get $WORK/remote/b.bin $WORK/back.bin
+rm $WORK/remote/b.bin
+rmdir $WORK/remote
+EOF
+# on stdin: -b would turn on BatchMode, and with it off askpass
+OUTPUT=$(timeout $TIMEOUT sftp $SFTP_OPTS user@localhost < $WORK/batch 2>&1 || true)
+
+check "put and rename" "$(echo "$OUTPUT" | grep -c "^$WORK/remote/b\.bin *$" || true)" "1"
+check "get" "$(sha256sum $WORK/back.bin 2>/dev/null | cut -d' ' -f1)" "$WANT"
+check "rm and rmdir" "$(test -e $WORK/remote && echo left || echo gone)" "gone"
+
+kill $SERVER_PID 2>/dev/null || true
+wait $SERVER_PID 2>/dev/null || true
+rm -rf $WORK
+
+if [ $FAILED -eq 0 ]; then
+    echo "✓ PASS: sftp put/get round-trip"
+    exit 0
+else
+    echo "✗ FAIL: sftp misbehaved"
+    echo "  Output: $OUTPUT"
+    cat $VERSION/test_sftp.log
+    exit 1
+fi
@@ -38,6 +38,55 @@ static uint8_t aes_sbox(uint8_t a) {
     return (uint8_t)(s ^ 0x63);
 }
 
+#if defined(NANO_SPEED) && !defined(NANO_AES_CT)
+#define AES128_TTABLE 1
+#endif
+
+#ifdef NANO_SPEED
+/* Speed build: aes_gentables() (call before the first key expansion) picks
+ * the AES-NI path when the CPU has one and, unless the bitsliced backend is
+ * selected, generates the S-box and one 32-bit T-table from aes_sbox() so
+ * that rounds work on whole columns. aes_te[a] is the column MixColumns
+ * makes of S(a) in row 0, bytes {2S, S, S, 3S} little-endian; rows 1..3 use
+ * it rotated by 8, 16, 24 bits. Table lookups are indexed by secret state,
+ * so this trades the computed S-box's constant timing for speed. Each
+ * translation unit has its own copy; ssh.c's is the one in use. */
+#ifdef AES128_TTABLE
+static uint8_t aes_sb[256];
+static uint32_t aes_te[256];
+#endif
+
+#ifdef __x86_64__
+static int aes_ni;      /* CPUID.1:ECX.AES[bit 25]: use the AES-NI path */
+
+static inline int aes_cpu_ni(void) {
+    uint32_t a = 1, b, c = 0, d;
+    __asm__("cpuid" : "+a"(a), "=b"(b), "+c"(c), "=d"(d));
+    return (c >> 25) & 1;
+}
+#endif
+
+static inline void aes_gentables(void) {
+#ifdef __x86_64__
+    aes_ni = aes_cpu_ni();
+#endif
+#ifdef AES128_TTABLE
+    for (int a = 0; a < 256; a++) {
+        uint8_t s = aes_sbox((uint8_t)a), s2 = aes_gmul(s, 2);
+        aes_sb[a] = s;
+        aes_te[a] = s2 | (uint32_t)s << 8 | (uint32_t)s << 16 |
+                    (uint32_t)(s2 ^ s) << 24;
+    }
+#endif
+}
+#endif
+
+#ifdef AES128_TTABLE
+#define AES_SUB(x) aes_sb[x]
+#else
+#define AES_SUB(x) aes_sbox(x)
+#endif
+
 /* Round constants for key expansion - 10 bytes (we only need first 10) */
 static const uint8_t rcon[10] = {
     0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36
@@ -46,12 +95,164 @@ static const uint8_t rcon[10] = {
 /* Galois Field multiplication by 2 */
 #define xtime(x) (((x) << 1) ^ (((x) & 0x80) ? 0x1b : 0x00))
 
+#ifdef NANO_AES_CT
+typedef uint32_t aes_bs __attribute__((vector_size(16)));  /* one bit-plane */
+#endif
+
 /* AES context for CTR mode */
 typedef struct {
     uint8_t round_keys[176];  /* 11 round keys × 16 bytes */
     uint8_t counter[16];      /* CTR mode counter */
+#ifdef NANO_AES_CT
+    aes_bs rk[11][8];         /* round keys as planes, packed at init */
+    uint8_t ks[128];          /* keystream of the last 8-block pass */
+    uint8_t ksc[16];          /* counter its unused blocks start at */
+    uint8_t ksn;              /* unused blocks, at the end of ks */
+#endif
 } aes128_ctr_ctx;
 
+#ifdef NANO_AES_CT
+/* Bitsliced constant-time backend (make AES_CT=1): no table lookups and no
+ * branches on key or data. Eight blocks are processed together as eight
+ * 128-bit planes: plane b holds bit b of every state byte, byte lane p of a
+ * plane is state byte p and bit k of that lane belongs to block k. In that
+ * layout ShiftRows is a 32-bit word rotation of each row, MixColumns a
+ * byte rotation inside each column word, and the S-box is evaluated on all
+ * 128 bytes at once as GF(2^8) inversion (a^254, four bitsliced multiplies)
+ * plus the affine map. GCC vector extensions: SSE2 on x86-64, plain 64-bit
+ * logic elsewhere. */
+
+/* 8x8 bit matrix transpose: bit c of byte r <-> bit r of byte c */
+static inline uint64_t aes_tr8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;  x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull; x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull; x ^= t ^ (t << 28);
+    return x;
+}
+
+/* 8 blocks (block k at in + 16k) -> planes, and back */
+static inline void aes_bs_pack(aes_bs *q, const uint8_t *in) {
+    uint8_t pl[8][16];
+    for (int p = 0; p < 16; p++) {
+        uint64_t x = 0;
+        for (int k = 0; k < 8; k++) x |= (uint64_t)in[16 * k + p] << (8 * k);
+        x = aes_tr8(x);
+        for (int b = 0; b < 8; b++) pl[b][p] = (uint8_t)(x >> (8 * b));
+    }
+    __builtin_memcpy(q, pl, sizeof(pl));
+}
+
+static inline void aes_bs_unpack(uint8_t *out, const aes_bs *q) {
+    uint8_t pl[8][16];
+    __builtin_memcpy(pl, q, sizeof(pl));
+    for (int p = 0; p < 16; p++) {
+        uint64_t x = 0;
+        for (int b = 0; b < 8; b++) x |= (uint64_t)pl[b][p] << (8 * b);
+        x = aes_tr8(x);
+        for (int k = 0; k < 8; k++) out[16 * k + p] = (uint8_t)(x >> (8 * k));
+    }
+}
+
+/* p[0..15) mod x^8 + x^4 + x^3 + x + 1 */
+static inline void aes_bs_reduce(aes_bs *r, aes_bs *p) {
+    for (int k = 14; k >= 8; k--) {
+        p[k - 8] ^= p[k];
+        p[k - 7] ^= p[k];
+        p[k - 5] ^= p[k];
+        p[k - 4] ^= p[k];
+    }
+    for (int k = 0; k < 8; k++) r[k] = p[k];
+}
+
+static inline void aes_bs_mul(aes_bs *r, const aes_bs *a, const aes_bs *b) {
+    aes_bs p[15];
+    for (int k = 0; k < 15; k++) p[k] = (aes_bs){0};
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 8; j++) p[i + j] ^= a[i] & b[j];
+    aes_bs_reduce(r, p);
+}
+
+/* r = a^(2^n): squaring is linear, just spread and reduce */
+static inline void aes_bs_sqr(aes_bs *r, const aes_bs *a, int n) {
+    aes_bs p[15];
+    for (int k = 0; k < 8; k++) r[k] = a[k];
+    while (n--) {
+        for (int k = 0; k < 15; k++) p[k] = k & 1 ? (aes_bs){0} : r[k / 2];
+        aes_bs_reduce(r, p);
+    }
+}
+
+static inline void aes_bs_sbox(aes_bs *q) {
+    aes_bs x2[8], x3[8], x12[8], x14[8], x15[8], t[8];
+    aes_bs_sqr(x2, q, 1);
+    aes_bs_mul(x3, x2, q);
+    aes_bs_sqr(x12, x3, 2);
+    aes_bs_mul(x14, x12, x2);
+    aes_bs_mul(x15, x12, x3);
+    aes_bs_sqr(t, x15, 4);
+    aes_bs_mul(x2, t, x14);             /* a^254 = a^-1 */
+    for (int i = 0; i < 8; i++) {
+        q[i] = x2[i] ^ x2[(i + 4) & 7] ^ x2[(i + 5) & 7] ^
+               x2[(i + 6) & 7] ^ x2[(i + 7) & 7];
+        if ((0x63 >> i) & 1) q[i] = ~q[i];
+    }
+}
+
+/* Row r (byte r of each column word) moves r columns to the left */
+static inline void aes_bs_shift_rows(aes_bs *q) {
+    const aes_bs m = {0xff, 0xff, 0xff, 0xff};
+    for (int b = 0; b < 8; b++) {
+        aes_bs x = q[b];
+        q[b] = (x & m) |
+               __builtin_shuffle(x & (m << 8), (aes_bs){1, 2, 3, 0}) |
+               __builtin_shuffle(x & (m << 16), (aes_bs){2, 3, 0, 1}) |
+               __builtin_shuffle(x & (m << 24), (aes_bs){3, 0, 1, 2});
+    }
+}
+
+#define AES_BS_ROT(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/* out_i = 2a_i ^ 3a_(i+1) ^ a_(i+2) ^ a_(i+3); t = a ^ rot1(a) */
+static inline void aes_bs_mix_columns(aes_bs *q) {
+    aes_bs r1[8], t[8];
+    for (int b = 0; b < 8; b++) {
+        r1[b] = AES_BS_ROT(q[b], 8);
+        t[b] = q[b] ^ r1[b];
+    }
+    for (int b = 0; b < 8; b++) {
+        aes_bs x2 = b ? t[b - 1] : (aes_bs){0};
+        if ((0x1b >> b) & 1) x2 ^= t[7];
+        q[b] = x2 ^ r1[b] ^ AES_BS_ROT(t[b], 16);
+    }
+}
+
+static inline void aes_bs_encrypt(const aes_bs (*rk)[8], aes_bs *q) {
+    for (int b = 0; b < 8; b++) q[b] ^= rk[0][b];
+    for (int round = 1; round < 10; round++) {
+        aes_bs_sbox(q);
+        aes_bs_shift_rows(q);
+        aes_bs_mix_columns(q);
+        for (int b = 0; b < 8; b++) q[b] ^= rk[round][b];
+    }
+    aes_bs_sbox(q);
+    aes_bs_shift_rows(q);
+    for (int b = 0; b < 8; b++) q[b] ^= rk[10][b];
+}
+
+/* SubWord for the key schedule through the same circuit */
+static inline void aes_bs_subword(uint8_t *w) {
+    uint8_t blk[128];
+    aes_bs q[8];
+    memset(blk, 0, sizeof(blk));
+    memcpy(blk, w, 4);
+    aes_bs_pack(q, blk);
+    aes_bs_sbox(q);
+    aes_bs_unpack(blk, q);
+    memcpy(w, blk, 4);
+}
+#endif
+
 /*
  * Key expansion for AES-128
  * Expands 128-bit key to 11 round keys (176 bytes)
@@ -84,10 +285,14 @@ static inline void aes128_key_expansion(const uint8_t *key, uint8_t *w) {
             temp[3] = t;
 
             /* SubWord: apply S-box to each byte */
-            temp[0] = aes_sbox(temp[0]);
-            temp[1] = aes_sbox(temp[1]);
-            temp[2] = aes_sbox(temp[2]);
-            temp[3] = aes_sbox(temp[3]);
+#ifdef NANO_AES_CT
+            aes_bs_subword(temp);
+#else
+            temp[0] = AES_SUB(temp[0]);
+            temp[1] = AES_SUB(temp[1]);
+            temp[2] = AES_SUB(temp[2]);
+            temp[3] = AES_SUB(temp[3]);
+#endif
 
             /* XOR with round constant */
             temp[0] ^= rcon[(i / 16) - 1];
@@ -115,7 +320,7 @@ static inline void add_round_key(uint8_t *state, const uint8_t *round_key) {
  */
 static inline void sub_bytes(uint8_t *state) {
     for (int i = 0; i < 16; i++) {
-        state[i] = aes_sbox(state[i]);
+        state[i] = AES_SUB(state[i]);
     }
 }
 
@@ -175,6 +380,43 @@ static inline void mix_columns(uint8_t *state) {
     memcpy(state, temp, 16);
 }
 
+#ifdef AES128_TTABLE
+static inline uint32_t aes_ld32(const uint8_t *p) {
+    uint32_t v;
+    __builtin_memcpy(&v, p, 4);
+    return v;
+}
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/* Rounds on four little-endian column words: ShiftRows is folded into
+ * which column each row's byte is taken from (row r from column c + r). */
+static inline void aes128_encrypt_block(const uint8_t *round_keys, uint8_t *block) {
+    uint32_t s[4], t[4];
+    for (int c = 0; c < 4; c++)
+        s[c] = aes_ld32(block + 4 * c) ^ aes_ld32(round_keys + 4 * c);
+
+    for (int round = 1; round < 10; round++) {
+        const uint8_t *rk = round_keys + round * 16;
+        for (int c = 0; c < 4; c++)
+            t[c] = aes_te[s[c] & 0xff] ^
+                   ROL32(aes_te[(s[(c + 1) & 3] >> 8) & 0xff], 8) ^
+                   ROL32(aes_te[(s[(c + 2) & 3] >> 16) & 0xff], 16) ^
+                   ROL32(aes_te[s[(c + 3) & 3] >> 24], 24) ^
+                   aes_ld32(rk + 4 * c);
+        memcpy(s, t, sizeof(s));
+    }
+
+    for (int c = 0; c < 4; c++) {
+        t[c] = (aes_sb[s[c] & 0xff] |
+                (uint32_t)aes_sb[(s[(c + 1) & 3] >> 8) & 0xff] << 8 |
+                (uint32_t)aes_sb[(s[(c + 2) & 3] >> 16) & 0xff] << 16 |
+                (uint32_t)aes_sb[s[(c + 3) & 3] >> 24] << 24) ^
+               aes_ld32(round_keys + 160 + 4 * c);
+        __builtin_memcpy(block + 4 * c, &t[c], 4);
+    }
+}
+#else
 /*
  * AES-128 encryption (one block)
  * Encrypts 16-byte block using expanded round keys
@@ -196,6 +438,7 @@ static inline void aes128_encrypt_block(const uint8_t *round_keys, uint8_t *bloc
     shift_rows(block);
     add_round_key(block, round_keys + 10 * 16);
 }
+#endif
 
 /*
  * Increment counter (big-endian)
@@ -208,14 +451,168 @@ static inline void increment_counter(uint8_t *counter) {
     }
 }
 
+#if defined(NANO_SPEED) && defined(__x86_64__)
+/* AES-NI path (speed build, x86-64). Compiled with a per-function target
+ * attribute and entered only if CPUID reports AES, so the binary still runs
+ * on CPUs without it. Round keys keep the FIPS-197 byte layout, so a context
+ * is valid for either path. Builtins rather than <wmmintrin.h>: the
+ * intrinsic headers drag in mm_malloc.h/libc. */
+#define AES128_NI 1
+#define AESNI __attribute__((target("aes,sse2")))
+
+typedef long long aes_v2di __attribute__((vector_size(16)));
+typedef int aes_v4si __attribute__((vector_size(16)));
+
+static inline AESNI aes_v2di aesni_ld(const uint8_t *p) {
+    aes_v2di v;
+    __builtin_memcpy(&v, p, 16);
+    return v;
+}
+
+static inline AESNI void aesni_st(uint8_t *p, aes_v2di v) {
+    __builtin_memcpy(p, &v, 16);
+}
+
+/* One key schedule step: g = AESKEYGENASSIST(prev, rcon) */
+static inline AESNI aes_v2di aesni_expand(aes_v2di k, aes_v2di g) {
+    g = (aes_v2di)__builtin_ia32_pshufd((aes_v4si)g, 0xff);
+    k ^= __builtin_ia32_pslldqi128(k, 32);
+    k ^= __builtin_ia32_pslldqi128(k, 32);
+    k ^= __builtin_ia32_pslldqi128(k, 32);
+    return k ^ g;
+}
+
+/* rcon must be an immediate, hence the unrolled steps */
+#define AESNI_RK(i, rc) \
+    k = aesni_expand(k, __builtin_ia32_aeskeygenassist128(k, rc)); \
+    aesni_st(w + 16 * (i), k)
+
+static inline AESNI void aesni_key_expansion(const uint8_t *key, uint8_t *w) {
+    aes_v2di k = aesni_ld(key);
+    aesni_st(w, k);
+    AESNI_RK(1, 0x01); AESNI_RK(2, 0x02); AESNI_RK(3, 0x04);
+    AESNI_RK(4, 0x08); AESNI_RK(5, 0x10); AESNI_RK(6, 0x20);
+    AESNI_RK(7, 0x40); AESNI_RK(8, 0x80); AESNI_RK(9, 0x1b);
+    AESNI_RK(10, 0x36);
+}
+
+#define AESNI_WAY 8     /* blocks in flight: covers AESENC latency */
+
+/* Counter block ctr + j, from the counter held as two native halves */
+static inline AESNI aes_v2di aesni_ctr(uint64_t hi, uint64_t lo, uint64_t j) {
+    uint64_t l = lo + j;
+    return (aes_v2di){ (long long)__builtin_bswap64(hi + (l < lo)),
+                       (long long)__builtin_bswap64(l) };
+}
+
+/* Same semantics as the portable loop below (a trailing partial block
+ * still consumes a whole counter). Full strides keep AESNI_WAY independent
+ * blocks going through each round together so the AES unit stays busy. */
+static inline AESNI void aesni_ctr_crypt(aes128_ctr_ctx *ctx,
+                                         uint8_t *data, size_t len) {
+    aes_v2di rk[11], b[AESNI_WAY];
+    uint64_t hi, lo;
+    for (int r = 0; r < 11; r++) rk[r] = aesni_ld(ctx->round_keys + 16 * r);
+    __builtin_memcpy(&hi, ctx->counter, 8);
+    __builtin_memcpy(&lo, ctx->counter + 8, 8);
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+
+    for (; len >= 16 * AESNI_WAY; len -= 16 * AESNI_WAY) {
+        for (int j = 0; j < AESNI_WAY; j++) b[j] = aesni_ctr(hi, lo, j) ^ rk[0];
+        for (int r = 1; r < 10; r++)
+            for (int j = 0; j < AESNI_WAY; j++)
+                b[j] = __builtin_ia32_aesenc128(b[j], rk[r]);
+        for (int j = 0; j < AESNI_WAY; j++) {
+            b[j] = __builtin_ia32_aesenclast128(b[j], rk[10]);
+            aesni_st(data, aesni_ld(data) ^ b[j]);
+            data += 16;
+        }
+        hi += (lo + AESNI_WAY < lo);
+        lo += AESNI_WAY;
+    }
+    for (; len > 0; hi += (lo + 1 < lo), lo++) {
+        uint8_t ks[16];
+        aes_v2di k = aesni_ctr(hi, lo, 0) ^ rk[0];
+        for (int r = 1; r < 10; r++) k = __builtin_ia32_aesenc128(k, rk[r]);
+        k = __builtin_ia32_aesenclast128(k, rk[10]);
+        size_t n = len < 16 ? len : 16;
+        aesni_st(ks, k);
+        for (size_t i = 0; i < n; i++) data[i] ^= ks[i];
+        data += n;
+        len -= n;
+    }
+
+    hi = __builtin_bswap64(hi);
+    lo = __builtin_bswap64(lo);
+    __builtin_memcpy(ctx->counter, &hi, 8);
+    __builtin_memcpy(ctx->counter + 8, &lo, 8);
+}
+#endif
+
+#ifdef NANO_AES_CT
+/* Round keys to planes, once per key: every block of a pass uses them */
+static inline void aes_bs_key(aes128_ctr_ctx *ctx) {
+    uint8_t blk[128];
+    for (int r = 0; r < 11; r++) {
+        for (int k = 0; k < 8; k++)
+            memcpy(blk + 16 * k, ctx->round_keys + 16 * r, 16);
+        aes_bs_pack(ctx->rk[r], blk);
+    }
+    ctx->ksn = 0;
+}
+
+/* Bitsliced CTR: a pass always makes eight counter blocks, so the blocks
+ * a short call leaves over (a packet's first block, read ahead of the
+ * rest) serve the next call, as long as the caller has not set a counter
+ * of its own (UMAC) in between. Like the loop below, a trailing partial
+ * block still consumes a whole counter. */
+static inline void aes_bs_ctr_crypt(aes128_ctr_ctx *ctx,
+                                    uint8_t *data, size_t len) {
+    while (len > 0) {
+        if (!ctx->ksn || memcmp(ctx->ksc, ctx->counter, 16)) {
+            aes_bs q[8];
+            uint8_t c[16];
+            memcpy(c, ctx->counter, 16);
+            for (int k = 0; k < 8; k++) {
+                memcpy(ctx->ks + 16 * k, c, 16);
+                increment_counter(c);
+            }
+            aes_bs_pack(q, ctx->ks);
+            aes_bs_encrypt((const aes_bs (*)[8])ctx->rk, q);
+            aes_bs_unpack(ctx->ks, q);
+            ctx->ksn = 8;
+        }
+        const uint8_t *ks = ctx->ks + 16 * (8 - ctx->ksn);
+        size_t n = (size_t)16 * ctx->ksn;
+        if (n > len) n = len;
+        for (size_t i = 0; i < n; i++) data[i] ^= ks[i];
+        for (size_t i = 0; i < n; i += 16) {
+            increment_counter(ctx->counter);
+            ctx->ksn--;
+        }
+        memcpy(ctx->ksc, ctx->counter, 16);
+        data += n;
+        len -= n;
+    }
+}
+#endif
+
 /*
  * Initialize AES-128-CTR context
  */
 static inline void aes128_ctr_init(aes128_ctr_ctx *ctx,
                                     const uint8_t *key,
                                     const uint8_t *iv) {
+#ifdef AES128_NI
+    if (aes_ni) aesni_key_expansion(key, ctx->round_keys);
+    else
+#endif
     aes128_key_expansion(key, ctx->round_keys);
     memcpy(ctx->counter, iv, 16);
+#ifdef NANO_AES_CT
+    aes_bs_key(ctx);
+#endif
 }
 
 /*
@@ -231,6 +628,12 @@ static inline void aes128_ctr_init(aes128_ctr_ctx *ctx,
 static inline void aes128_ctr_crypt(aes128_ctr_ctx *ctx,
                                      uint8_t *data,
                                      size_t len) {
+#ifdef AES128_NI
+    if (aes_ni) { aesni_ctr_crypt(ctx, data, len); return; }
+#endif
+#ifdef NANO_AES_CT
+    aes_bs_ctr_crypt(ctx, data, len);
+#else
     uint8_t keystream[16];
     size_t i = 0;
 
@@ -251,6 +654,7 @@ static inline void aes128_ctr_crypt(aes128_ctr_ctx *ctx,
         i += block_len;
         len -= block_len;
     }
+#endif
 }
 
 #endif /* AES128_MINIMAL_H */
@@ -0,0 +1,306 @@
+/* deflate.c - zlib stream compression for SSH packets (see deflate.h). */
+
+#include "deflate.h"
+
+/* ---- length / distance codes (RFC 1951 3.2.5), generated once ---- */
+static uint16_t lbase[29], dbase[30];
+static uint8_t lext[29], dext[30];
+
+static void ztables(void) {
+    if (lbase[0]) return;
+    for (int i = 0, b = 3; i < 29; i++) {
+        lext[i] = i < 8 || i == 28 ? 0 : (i - 4) >> 2;
+        lbase[i] = i == 28 ? 258 : b;
+        b += 1 << lext[i];
+    }
+    for (int i = 0, b = 1; i < 30; i++) {
+        dext[i] = i < 4 ? 0 : (i - 2) >> 1;
+        dbase[i] = b;
+        b += 1 << dext[i];
+    }
+}
+
+/* ================================================================== */
+/* Compressor                                                          */
+/* ================================================================== */
+
+/* Bits go out LSB first; Huffman codes MSB first, hence rev(). Nothing is
+ * written past cap, but n keeps counting so overflow is noticed. */
+typedef struct { uint8_t *o; size_t n, cap; uint32_t bb; int bc; } zw_t;
+
+static void put(zw_t *w, uint32_t v, int n) {
+    w->bb |= v << w->bc;
+    for (w->bc += n; w->bc >= 8; w->bc -= 8, w->bb >>= 8, w->n++)
+        if (w->n < w->cap) w->o[w->n] = (uint8_t)w->bb;
+}
+
+static uint32_t rev(uint32_t c, int n) {
+    uint32_t r = 0;
+    while (n--) { r = r << 1 | (c & 1); c >>= 1; }
+    return r;
+}
+
+/* one literal/length symbol in the fixed code */
+static void put_sym(zw_t *w, unsigned s) {
+    if (s < 144) put(w, rev(0x30 + s, 8), 8);
+    else if (s < 256) put(w, rev(0x190 + s - 144, 9), 9);
+    else if (s < 280) put(w, rev(s - 256, 7), 7);
+    else put(w, rev(0xc0 + s - 280, 8), 8);
+}
+
+static uint32_t zhash(const uint8_t *p) {
+    return (uint32_t)(p[0] | p[1] << 8 | p[2] << 16) * 2654435761u >> 20;
+}
+
+void zdef_reset(zdef_t *z) {
+    memset(z->head, 0, sizeof z->head);
+    z->pos = 0; z->started = 0; z->wl = 0;
+}
+
+size_t zdef_packet(zdef_t *z, uint8_t *buf, size_t n) {
+    uint8_t *p = z->win + z->wl;        /* the packet, behind its history */
+    size_t hl = z->started ? 0 : 2, i = 0;
+    uint32_t at0 = z->pos + (uint32_t)z->wl;
+    zw_t w = { buf + hl, 0, n + 5, 0, 0 };     /* no longer than stored */
+    ztables();
+    memcpy(p, buf, n);
+
+    /* one fixed-code block, greedy matches */
+    put(&w, 2, 3);                      /* BFINAL 0, BTYPE 01 */
+    while (i < n && w.n <= w.cap) {
+        size_t len = 0, max = n - i < 258 ? n - i : 258;
+        uint32_t d = 0;
+        if (max >= 3) {
+            uint32_t k = zhash(p + i), c = z->head[k];
+            z->head[k] = at0 + (uint32_t)i + 1;
+            d = at0 + (uint32_t)i + 1 - c;  /* any byte in reach will do */
+            if (c && d - 1 < z->wl + i && d <= ZWIN)
+                while (len < max && p[i + len - d] == p[i + len]) len++;
+        }
+        if (len < 3) { put_sym(&w, p[i++]); continue; }
+        int li = 28, di = 29;
+        while (lbase[li] > len) li--;
+        while (dbase[di] > d) di--;
+        put_sym(&w, 257 + li);
+        put(&w, (uint32_t)(len - lbase[li]), lext[li]);
+        put(&w, rev(di, 5), 5);
+        put(&w, (uint32_t)(d - dbase[di]), dext[di]);
+        for (size_t j = i + 1; j < i + len && n - j >= 3; j++)
+            z->head[zhash(p + j)] = at0 + (uint32_t)j + 1;
+        i += len;
+    }
+    put_sym(&w, 256);
+    put(&w, 0, 3);                      /* sync flush: empty stored block */
+    if (w.bc) put(&w, 0, 8 - w.bc);
+    put(&w, 0xffff0000, 32);
+    if (i < n || w.n > w.cap) {         /* did not pay: one stored block */
+        uint8_t *o = buf + hl;
+        o[0] = 0;
+        o[1] = (uint8_t)n; o[2] = (uint8_t)(n >> 8);
+        o[3] = (uint8_t)~n; o[4] = (uint8_t)(~n >> 8);
+        memcpy(o + 5, p, n);
+        w.n = 5 + n;
+    }
+    if (!z->started) { buf[0] = 0x78; buf[1] = 0x01; z->started = 1; }
+
+    z->wl += n;
+    if (z->wl > ZWIN) {
+        size_t k = z->wl - ZWIN;
+        memmove(z->win, z->win + k, ZWIN);
+        z->pos += (uint32_t)k;
+        z->wl = ZWIN;
+    }
+    return hl + w.n;
+}
+
+/* ================================================================== */
+/* Decompressor                                                        */
+/* ================================================================== */
+
+/* Input is what the last packet left undecoded, then this packet. Bits
+ * past the end read as 0 and set eoi: the unit being decoded is then
+ * rolled back and waits for the next packet. */
+typedef struct {
+    const uint8_t *c, *in;
+    size_t cl, n, pos;
+    uint32_t bb;
+    int bc, eoi;
+} zr_t;
+
+static int zbyte(zr_t *r) {
+    size_t i = r->pos;
+    if (i >= r->cl + r->n) return -1;
+    r->pos++;
+    return i < r->cl ? r->c[i] : r->in[i - r->cl];
+}
+
+static uint32_t bits(zr_t *r, int n) {
+    uint32_t v = 0;
+    for (int i = 0; i < n; i++) {
+        if (!r->bc) {
+            int b = zbyte(r);
+            if (b < 0) { r->eoi = 1; return 0; }
+            r->bb = (uint32_t)b; r->bc = 8;
+        }
+        v |= (r->bb & 1) << i;
+        r->bb >>= 1; r->bc--;
+    }
+    return v;
+}
+
+/* canonical code from code lengths; <0 over-subscribed, >0 incomplete */
+static int zbuild(zhuff_t *h, const uint8_t *len, int n) {
+    uint16_t off[16];
+    int left = 1;
+    memset(h->cnt, 0, sizeof(h->cnt));
+    for (int s = 0; s < n; s++) h->cnt[len[s]]++;
+    if (h->cnt[0] == n) return 0;
+    for (int l = 1; l < 16; l++) {
+        left = (left << 1) - h->cnt[l];
+        if (left < 0) return left;
+    }
+    off[1] = 0;
+    for (int l = 1; l < 15; l++) off[l + 1] = off[l] + h->cnt[l];
+    for (int s = 0; s < n; s++)
+        if (len[s]) h->sym[off[len[s]]++] = (uint16_t)s;
+    return left;
+}
+
+static int zdecode(zr_t *r, const zhuff_t *h) {
+    int code = 0, first = 0, index = 0;
+    for (int l = 1; l < 16; l++) {
+        code |= (int)bits(r, 1);
+        int count = h->cnt[l];
+        if (code - count < first) return h->sym[index + code - first];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static void zfixed(zinf_t *z) {
+    uint8_t len[288];
+    for (int s = 0; s < 288; s++)
+        len[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+    zbuild(&z->lit, len, 288);
+    memset(len, 5, 30);
+    zbuild(&z->dist, len, 30);
+}
+
+/* dynamic block header (RFC 1951 3.2.7); -1 if malformed */
+static int zdynamic(zinf_t *z, zr_t *r) {
+    static const uint8_t ord[19] =
+        { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+    uint8_t len[286 + 30];
+    zhuff_t lc;
+    int nlen = (int)bits(r, 5) + 257, ndist = (int)bits(r, 5) + 1;
+    int ncode = (int)bits(r, 4) + 4;
+    if (nlen > 286 || ndist > 30) return -1;
+    for (int i = 0; i < 19; i++) len[ord[i]] = i < ncode ? (uint8_t)bits(r, 3) : 0;
+    if (zbuild(&lc, len, 19)) return -1;
+    for (int i = 0; i < nlen + ndist; ) {
+        int s = zdecode(r, &lc), rep = 1;
+        uint8_t v = (uint8_t)s;
+        if (r->eoi) return 0;
+        if (s < 0) return -1;
+        if (s == 16) {
+            if (!i) return -1;
+            v = len[i - 1]; rep = 3 + (int)bits(r, 2);
+        } else if (s > 16) {
+            v = 0; rep = s == 17 ? 3 + (int)bits(r, 3) : 11 + (int)bits(r, 7);
+        }
+        if (i + rep > nlen + ndist) return -1;
+        while (rep--) len[i++] = v;
+    }
+    if (!len[256]) return -1;
+    int e = zbuild(&z->lit, len, nlen);
+    if (e < 0 || (e > 0 && nlen - z->lit.cnt[0] != 1)) return -1;
+    e = zbuild(&z->dist, len + nlen, ndist);
+    if (e < 0 || (e > 0 && ndist - z->dist.cnt[0] != 1)) return -1;
+    return 0;
+}
+
+enum { Z_HDR, Z_BLOCK, Z_STORED, Z_CODES };
+
+void zinf_reset(zinf_t *z) {
+    z->st = Z_HDR; z->last = 0; z->left = 0;
+    z->bb = 0; z->bc = 0; z->cl = 0; z->wl = 0;
+}
+
+uint8_t *zinf_packet(zinf_t *z, const uint8_t *in, size_t *n) {
+    zr_t r = { z->carry, in, z->cl, *n, 0, z->bb, z->bc, 0 }, ck;
+    if (z->wl > ZWIN) {                 /* keep the window, drop the rest */
+        memmove(z->win, z->win + z->wl - ZWIN, ZWIN);
+        z->wl = ZWIN;
+    }
+    uint8_t *o0 = z->win + z->wl, *o = o0, *oend = o0 + ZPKT_MAX;
+    ztables();
+    for (;;) {
+        ck = r;
+        if (z->st == Z_HDR) {           /* CM 8, no preset dictionary */
+            uint32_t h = bits(&r, 16), cmf = h & 0xff;
+            if (r.eoi) break;
+            if ((cmf & 15) != 8 || (cmf << 8 | h >> 8) % 31 || h & 0x2000)
+                return 0;
+            z->st = Z_BLOCK;
+        } else if (z->st == Z_BLOCK) {
+            if (z->last) {              /* stream over: nothing may follow */
+                if (r.pos < r.cl + r.n) return 0;
+                break;
+            }
+            uint32_t last = bits(&r, 1), type = bits(&r, 2), l = 0;
+            int e = 0;
+            if (type == 0) {
+                r.bc = 0;               /* to a byte boundary */
+                l = bits(&r, 32);
+            } else if (type == 1) zfixed(z);
+            else if (type == 2) e = zdynamic(z, &r);
+            if (r.eoi) break;
+            if (type == 3 || e || (type == 0 && ((l ^ l >> 16) & 0xffff) != 0xffff))
+                return 0;
+            z->left = (uint16_t)l;
+            z->last = (uint8_t)last;
+            z->st = type ? Z_CODES : Z_STORED;
+        } else if (z->st == Z_STORED) {
+            int b = 0;
+            while (z->left && (b = zbyte(&r)) >= 0) {
+                if (o == oend) return 0;
+                *o++ = (uint8_t)b;
+                z->left--;
+            }
+            if (z->left) { ck = r; break; }
+            z->st = Z_BLOCK;
+        } else {
+            int s = zdecode(&r, &z->lit), len = 0, d = 0;
+            if (s > 256) {
+                s -= 257;
+                if (s >= 29) { if (r.eoi) break; return 0; }
+                len = lbase[s] + (int)bits(&r, lext[s]);
+                s = zdecode(&r, &z->dist);
+                if (s < 0 || s >= 30) { if (r.eoi) break; return 0; }
+                d = dbase[s] + (int)bits(&r, dext[s]);
+                s = 257;
+            }
+            if (r.eoi) break;
+            if (s < 0) return 0;
+            if (s == 256) { z->st = Z_BLOCK; continue; }
+            if (s < 256) { d = 0; len = 1; }
+            if (len > oend - o || d > o - z->win) return 0;
+            if (!d) *o++ = (uint8_t)s;
+            else while (len--) { *o = o[-d]; o++; }
+        }
+    }
+
+    /* roll back to the unit that ran out and carry it over */
+    size_t k = ck.pos, left = ck.cl + ck.n - k;
+    uint8_t t[ZCARRY];
+    if (left > ZCARRY) return 0;
+    for (size_t i = 0; i < left; i++) t[i] = (uint8_t)zbyte(&ck);
+    memcpy(z->carry, t, left);
+    z->cl = left;
+    z->bb = ck.bb; z->bc = ck.bc;
+    z->wl += (size_t)(o - o0);
+    *n = (size_t)(o - o0);
+    return o0;
+}
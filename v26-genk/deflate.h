@@ -0,0 +1,68 @@
+/* deflate.h - the zlib stream of "zlib@openssh.com" compression, one
+ * context per direction, in a few hundred lines and fixed memory.
+ *
+ * SSH compresses each packet's payload as the next piece of one endless
+ * zlib stream (RFC 4253 6.2): every packet ends on a flush, so it can be
+ * decoded on its own, but matches may reach back into earlier packets.
+ *
+ * The compressor is deliberately simple: greedy LZ77 over a 32 KB window
+ * with one hash probe per position, fixed Huffman codes, a sync flush per
+ * packet, and a stored block whenever that would come out shorter. Shell
+ * and log output still shrinks several times over, for a fraction of
+ * zlib's code. The decompressor takes any valid stream (stored, fixed and
+ * dynamic blocks, flushes landing mid-byte as zlib's Z_PARTIAL_FLUSH does).
+ * Both keep their window in the context: about 100 KB each, only touched
+ * once compression starts.
+ */
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stdint.h>
+#include "nolibc.h"
+
+#define ZPKT_MAX 35000              /* largest payload (>= SSH_PKT_MAX) */
+#define ZWIN 32768                  /* deflate window */
+#define ZHASH 4096                  /* compressor hash heads */
+#define ZCARRY 1024                 /* input a packet may leave undecoded */
+#define DEFLATE_GROW 8              /* most a payload grows compressed */
+
+typedef struct {
+    uint32_t head[ZHASH];           /* stream offset + 1 of the last
+                                     * position with that hash, 0: none */
+    uint32_t pos;                   /* stream offset of win[0] */
+    uint8_t started;                /* zlib header sent */
+    size_t wl;
+    uint8_t win[ZWIN + ZPKT_MAX];   /* history, then the packet */
+} zdef_t;
+
+typedef struct { uint16_t cnt[16], sym[288]; } zhuff_t;
+
+typedef struct {
+    uint8_t st;                     /* zlib header, block header, stored
+                                     * bytes or Huffman codes next */
+    uint8_t last;                   /* final block seen */
+    uint16_t left;                  /* stored bytes to go */
+    uint32_t bb;                    /* bits carried over, bc of them */
+    int bc;
+    size_t cl;
+    uint8_t carry[ZCARRY];          /* bytes not decoded yet */
+    zhuff_t lit, dist;              /* codes of the current block */
+    size_t wl;
+    uint8_t win[ZWIN + ZPKT_MAX];   /* history, then the packet */
+} zinf_t;
+
+/* Start over with a new stream, as OpenSSH does in each direction at every
+ * NEWKEYS once compression is on. */
+void zdef_reset(zdef_t *z);
+void zinf_reset(zinf_t *z);
+
+/* Compress the n-byte payload at buf in place; buf has DEFLATE_GROW bytes
+ * of room behind it. Returns the new length. */
+size_t zdef_packet(zdef_t *z, uint8_t *buf, size_t n);
+
+/* Decompress one packet's n-byte payload. Returns the payload (valid until
+ * the next call) with *n set to its length, or NULL if the stream is
+ * broken or the payload longer than ZPKT_MAX. */
+uint8_t *zinf_packet(zinf_t *z, const uint8_t *in, size_t *n);
+
+#endif /* DEFLATE_H */
@@ -36,6 +36,10 @@ static const uint8_t ed25519_base_x[F25519_SIZE] = {
 	0xfe, 0x53, 0x6e, 0xcd, 0xd3, 0x36, 0x69, 0x21
 };
 
+#ifdef NANO_SPEED
+static void base_table_gen(void);
+#endif
+
 void ed25519_gen(void)
 {
 	memcpy(ed25519_base.x, ed25519_base_x, F25519_SIZE);
@@ -45,6 +49,9 @@ void ed25519_gen(void)
 	f25519_mul__distinct(ed25519_base.t, ed25519_base.x, ed25519_base.y);
 	ed25519_neutral.y[0] = 1;
 	ed25519_neutral.z[0] = 1;
+#ifdef NANO_SPEED
+	base_table_gen();
+#endif
 }
 
 /* Conversion to and from projective coordinates */
@@ -319,4 +326,101 @@ void ed25519_smult(struct ed25519_pt *r_out, const struct ed25519_pt *p,
 
 	ed25519_copy(r_out, &r);
 }
+
+#ifdef NANO_SPEED
+/* Fixed-base table (ref10 layout): base_table[k][j] = (j+1) * 256^k * B
+ * for k < 32, j < 8. 256 points / 32 KB, built once at startup (before
+ * any fork, so worker processes share it copy-on-write).
+ *
+ * e is recoded into 64 signed radix-16 digits d[i] in [-8, 8], so that
+ *
+ *     eB = 16 * sum(d[2k+1] 256^k B) + sum(d[2k] 256^k B)
+ *
+ * and every term is one table entry, possibly negated.
+ */
+static struct ed25519_pt base_table[32][8];
+
+static void base_table_gen(void)
+{
+	struct ed25519_pt p;
+	int k, j;
+
+	ed25519_copy(&p, &ed25519_base);
+
+	for (k = 0; k < 32; k++) {
+		ed25519_copy(&base_table[k][0], &p);
+
+		for (j = 1; j < 8; j++)
+			ed25519_add(&base_table[k][j], &base_table[k][j - 1], &p);
+
+		for (j = 0; j < 8; j++)
+			ed25519_double(&p, &p);
+	}
+}
+
+/* r = d * 256^k * B, |d| <= 8, without secret-dependent branches or
+ * addresses: all eight entries are read and the match kept by masking.
+ */
+static void base_select(struct ed25519_pt *r, int k, int8_t d)
+{
+	const uint8_t neg = (uint8_t)d >> 7;
+	const uint8_t mag = d - ((2 * d) & -neg);
+	uint8_t t[F25519_SIZE];
+	int j;
+
+	ed25519_copy(r, &ed25519_neutral);
+
+	for (j = 0; j < 8; j++) {
+		const uint8_t hit =
+			((uint32_t)(mag ^ (j + 1)) - 1) >> 31;
+		const struct ed25519_pt *p = &base_table[k][j];
+
+		f25519_select(r->x, r->x, p->x, hit);
+		f25519_select(r->y, r->y, p->y, hit);
+		f25519_select(r->t, r->t, p->t, hit);
+		f25519_select(r->z, r->z, p->z, hit);
+	}
+
+	/* -(x, y, t, z) = (-x, y, -t, z) */
+	f25519_neg(t, r->x);
+	f25519_select(r->x, r->x, t, neg);
+	f25519_neg(t, r->t);
+	f25519_select(r->t, r->t, t, neg);
+}
+
+void ed25519_smult_base(struct ed25519_pt *r, const uint8_t *e)
+{
+	struct ed25519_pt s;
+	int8_t d[64];
+	int8_t carry = 0;
+	int i;
+
+	for (i = 0; i < 32; i++) {
+		d[2 * i] = e[i] & 15;
+		d[2 * i + 1] = e[i] >> 4;
+	}
+
+	for (i = 0; i < 63; i++) {
+		d[i] += carry;
+		carry = (d[i] + 8) >> 4;
+		d[i] -= carry << 4;
+	}
+	d[63] += carry;
+
+	ed25519_copy(r, &ed25519_neutral);
+
+	for (i = 1; i < 64; i += 2) {
+		base_select(&s, i >> 1, d[i]);
+		ed25519_add(r, r, &s);
+	}
+
+	for (i = 0; i < 4; i++)
+		ed25519_double(r, r);
+
+	for (i = 0; i < 64; i += 2) {
+		base_select(&s, i >> 1, d[i]);
+		ed25519_add(r, r, &s);
+	}
+}
+#endif
 #endif
@@ -82,5 +82,13 @@ void ed25519_double(struct ed25519_pt *r, const struct ed25519_pt *a);
 void ed25519_smult(struct ed25519_pt *r, const struct ed25519_pt *a,
 		   const uint8_t *e);
 
+#ifdef NANO_SPEED
+/* Fixed-base multiply r = eB through a table of small multiples of B built
+ * by ed25519_gen(): 64 additions and 4 doublings instead of 256 of each.
+ * Table lookups scan every entry, so timing does not depend on e.
+ */
+void ed25519_smult_base(struct ed25519_pt *r, const uint8_t *e);
+#endif
+
 #endif
 #endif
@@ -53,7 +53,11 @@ static void sm_pack(uint8_t *r, const uint8_t *k)
 {
 	struct ed25519_pt p;
 
+#ifdef NANO_SPEED
+	ed25519_smult_base(&p, k);
+#else
 	ed25519_smult(&p, &ed25519_base, k);
+#endif
 	pp(r, &p);
 }
 
@@ -0,0 +1,375 @@
+/* Arithmetic mod p = 2^255-19, 64-bit backend
+ *
+ * Drop-in replacement for f25519.c (make SPEED=1, or FIELD=f25519_51):
+ * same f25519.h interface, same 32-byte little-endian element format, so
+ * c25519_smult, ed25519_add/double and every caller speed up unchanged.
+ *
+ * Internally each operation unpacks its operands into five 51-bit limbs
+ * (the curve25519-donna-c64 layout, see v19-donna), multiplies with
+ * unsigned __int128 products and folds the top by 19. A product costs 25
+ * 64x64->128 multiplies instead of the byte backend's 1024-step schoolbook
+ * loop; squaring has its own 15-multiply routine, and the long inversion
+ * and square-root chains stay in limb form from start to finish.
+ *
+ * Requires a 64-bit target with unsigned __int128, little-endian.
+ */
+
+#include "f25519.h"
+
+typedef unsigned __int128 u128;
+
+#define M51 (((uint64_t)1 << 51) - 1)
+
+#ifdef FULL_C25519_CODE
+const uint8_t f25519_zero[F25519_SIZE] = {0};
+#endif
+const uint8_t f25519_one[F25519_SIZE] = {1};
+
+/* ---- limb form ---- */
+
+static inline uint64_t ld64(const uint8_t *p)
+{
+	uint64_t r;
+
+	__builtin_memcpy(&r, p, 8);
+	return r;
+}
+
+static inline void st64(uint8_t *p, uint64_t v)
+{
+	__builtin_memcpy(p, &v, 8);
+}
+
+/* Any 256-bit string; the top limb keeps bit 255 (< 2^52) */
+static void unpack(uint64_t *o, const uint8_t *a)
+{
+	const uint64_t w0 = ld64(a), w1 = ld64(a + 8);
+	const uint64_t w2 = ld64(a + 16), w3 = ld64(a + 24);
+
+	o[0] = w0 & M51;
+	o[1] = ((w0 >> 51) | (w1 << 13)) & M51;
+	o[2] = ((w1 >> 38) | (w2 << 26)) & M51;
+	o[3] = ((w2 >> 25) | (w3 << 39)) & M51;
+	o[4] = w3 >> 12;
+}
+
+/* Limbs below ~2^52 whose value is below 2^256 (true after carry()).
+ * Summed rather than OR-ed so slightly oversized limbs are fine. */
+static void pack(uint8_t *r, const uint64_t *t)
+{
+	u128 c = t[0] + ((u128)t[1] << 51);
+
+	st64(r, (uint64_t)c);
+	c = (c >> 64) + ((u128)t[2] << 38);
+	st64(r + 8, (uint64_t)c);
+	c = (c >> 64) + ((u128)t[3] << 25);
+	st64(r + 16, (uint64_t)c);
+	c = (c >> 64) + ((u128)t[4] << 12);
+	st64(r + 24, (uint64_t)c);
+}
+
+/* Propagate carries, folding 2^255 = 19. Limbs in: < 2^63.
+ * Out: limbs 1..4 < 2^51, limb 0 < 2^51 + 2^17, value < 2p. */
+static void carry(uint64_t *t)
+{
+	uint64_t c;
+
+	c = t[0] >> 51; t[0] &= M51; t[1] += c;
+	c = t[1] >> 51; t[1] &= M51; t[2] += c;
+	c = t[2] >> 51; t[2] &= M51; t[3] += c;
+	c = t[3] >> 51; t[3] &= M51; t[4] += c;
+	c = t[4] >> 51; t[4] &= M51; t[0] += c * 19;
+}
+
+/* Reduce 128-bit column sums to limbs < 2^52 */
+static void fold(uint64_t *r, u128 t0, u128 t1, u128 t2, u128 t3, u128 t4)
+{
+	uint64_t c;
+
+	r[0] = (uint64_t)t0 & M51; t1 += (uint64_t)(t0 >> 51);
+	r[1] = (uint64_t)t1 & M51; t2 += (uint64_t)(t1 >> 51);
+	r[2] = (uint64_t)t2 & M51; t3 += (uint64_t)(t2 >> 51);
+	r[3] = (uint64_t)t3 & M51; t4 += (uint64_t)(t3 >> 51);
+	r[4] = (uint64_t)t4 & M51;
+	c = (uint64_t)(t4 >> 51);
+	r[0] += c * 19;
+	r[1] += r[0] >> 51;
+	r[0] &= M51;
+}
+
+/* r = a * b; limbs in: < 2^52. r may alias a or b. */
+static void fmul(uint64_t *r, const uint64_t *a, const uint64_t *b)
+{
+	const uint64_t b1 = b[1] * 19, b2 = b[2] * 19;
+	const uint64_t b3 = b[3] * 19, b4 = b[4] * 19;
+	u128 t0, t1, t2, t3, t4;
+
+	t0 = (u128)a[0] * b[0] + (u128)a[1] * b4 + (u128)a[2] * b3 +
+	     (u128)a[3] * b2 + (u128)a[4] * b1;
+	t1 = (u128)a[0] * b[1] + (u128)a[1] * b[0] + (u128)a[2] * b4 +
+	     (u128)a[3] * b3 + (u128)a[4] * b2;
+	t2 = (u128)a[0] * b[2] + (u128)a[1] * b[1] + (u128)a[2] * b[0] +
+	     (u128)a[3] * b4 + (u128)a[4] * b3;
+	t3 = (u128)a[0] * b[3] + (u128)a[1] * b[2] + (u128)a[2] * b[1] +
+	     (u128)a[3] * b[0] + (u128)a[4] * b4;
+	t4 = (u128)a[0] * b[4] + (u128)a[1] * b[3] + (u128)a[2] * b[2] +
+	     (u128)a[3] * b[1] + (u128)a[4] * b[0];
+
+	fold(r, t0, t1, t2, t3, t4);
+}
+
+/* r = a^2: the cross terms appear twice, so 15 products instead of 25 */
+static void fsqr(uint64_t *r, const uint64_t *a)
+{
+	const uint64_t d0 = a[0] * 2, d1 = a[1] * 2, d2 = a[2] * 2;
+	const uint64_t d3 = a[3] * 2;
+	const uint64_t a3 = a[3] * 19, a4 = a[4] * 19;
+	u128 t0, t1, t2, t3, t4;
+
+	t0 = (u128)a[0] * a[0] + (u128)d1 * a4 + (u128)d2 * a3;
+	t1 = (u128)d0 * a[1] + (u128)d2 * a4 + (u128)a[3] * a3;
+	t2 = (u128)d0 * a[2] + (u128)a[1] * a[1] + (u128)d3 * a4;
+	t3 = (u128)d0 * a[3] + (u128)d1 * a[2] + (u128)a[4] * a4;
+	t4 = (u128)d0 * a[4] + (u128)d1 * a[3] + (u128)a[2] * a[2];
+
+	fold(r, t0, t1, t2, t3, t4);
+}
+
+/* r = a^(2^n) */
+static void fsqr_n(uint64_t *r, const uint64_t *a, int n)
+{
+	fsqr(r, a);
+	while (--n)
+		fsqr(r, r);
+}
+
+/* Shared prefix of the inversion and square-root chains:
+ * z11 = z^11, r = z^(2^250 - 1).
+ */
+static void pow_2250(uint64_t *r, uint64_t *z11, const uint64_t *z)
+{
+	uint64_t z9[5], a[5], b[5], c[5];
+
+	fsqr(a, z);			/* 2 */
+	fsqr_n(b, a, 2);		/* 8 */
+	fmul(z9, b, z);			/* 9 */
+	fmul(z11, z9, a);		/* 11 */
+	fsqr(b, z11);			/* 22 */
+	fmul(a, b, z9);			/* 2^5 - 1 */
+	fsqr_n(b, a, 5);
+	fmul(a, b, a);			/* 2^10 - 1 */
+	fsqr_n(b, a, 10);
+	fmul(b, b, a);			/* 2^20 - 1 */
+	fsqr_n(c, b, 20);
+	fmul(c, c, b);			/* 2^40 - 1 */
+	fsqr_n(c, c, 10);
+	fmul(a, c, a);			/* 2^50 - 1 */
+	fsqr_n(b, a, 50);
+	fmul(b, b, a);			/* 2^100 - 1 */
+	fsqr_n(c, b, 100);
+	fmul(c, c, b);			/* 2^200 - 1 */
+	fsqr_n(c, c, 50);
+	fmul(r, c, a);			/* 2^250 - 1 */
+}
+
+/* ---- byte-string interface (f25519.h) ---- */
+
+void f25519_load(uint8_t *x, uint32_t c)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(c); i++) {
+		x[i] = c;
+		c >>= 8;
+	}
+
+	for (; i < F25519_SIZE; i++)
+		x[i] = 0;
+}
+
+void f25519_normalize(uint8_t *x)
+{
+	uint8_t minusp[F25519_SIZE];
+	uint16_t c;
+	int i;
+
+	/* Reduce using 2^255 = 19 mod p */
+	c = (x[31] >> 7) * 19;
+	x[31] &= 127;
+
+	for (i = 0; i < F25519_SIZE; i++) {
+		c += x[i];
+		x[i] = c;
+		c >>= 8;
+	}
+
+	/* The number is now less than 2^255 + 18, and therefore less than
+	 * 2p. Try subtracting p, and conditionally load the subtracted
+	 * value if underflow did not occur.
+	 */
+	c = 19;
+
+	for (i = 0; i + 1 < F25519_SIZE; i++) {
+		c += x[i];
+		minusp[i] = c;
+		c >>= 8;
+	}
+
+	c += ((uint16_t)x[i]) - 128;
+	minusp[31] = c;
+
+	/* Load x-p if no underflow */
+	f25519_select(x, minusp, x, (c >> 15) & 1);
+}
+
+uint8_t f25519_eq(const uint8_t *x, const uint8_t *y)
+{
+	uint8_t sum = 0;
+	int i;
+
+	for (i = 0; i < F25519_SIZE; i++)
+		sum |= x[i] ^ y[i];
+
+	sum |= (sum >> 4);
+	sum |= (sum >> 2);
+	sum |= (sum >> 1);
+
+	return (sum ^ 1) & 1;
+}
+
+void f25519_select(uint8_t *dst,
+		   const uint8_t *zero, const uint8_t *one,
+		   uint8_t condition)
+{
+	const uint64_t mask = -(uint64_t)condition;
+	int i;
+
+	for (i = 0; i < F25519_SIZE; i += 8) {
+		const uint64_t z = ld64(zero + i);
+
+		st64(dst + i, z ^ (mask & (ld64(one + i) ^ z)));
+	}
+}
+
+void f25519_add(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	uint64_t x[5], y[5];
+	int i;
+
+	unpack(x, a);
+	unpack(y, b);
+	for (i = 0; i < 5; i++)
+		x[i] += y[i];
+	carry(x);
+	pack(r, x);
+}
+
+/* 4p, limb by limb: more than any unpacked limb, so a + 4p - b >= 0 */
+#define P4_0 ((M51 - 18) * 4)
+#define P4_N (M51 * 4)
+
+void f25519_sub(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	uint64_t x[5], y[5];
+	int i;
+
+	unpack(x, a);
+	unpack(y, b);
+	x[0] += P4_0 - y[0];
+	for (i = 1; i < 5; i++)
+		x[i] += P4_N - y[i];
+	carry(x);
+	pack(r, x);
+}
+
+void f25519_neg(uint8_t *r, const uint8_t *a)
+{
+	uint64_t x[5];
+	int i;
+
+	unpack(x, a);
+	x[0] = P4_0 - x[0];
+	for (i = 1; i < 5; i++)
+		x[i] = P4_N - x[i];
+	carry(x);
+	pack(r, x);
+}
+
+void f25519_mul__distinct(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	uint64_t x[5], y[5];
+
+	unpack(x, a);
+	if (a == b) {
+		fsqr(x, x);
+	} else {
+		unpack(y, b);
+		fmul(x, x, y);
+	}
+	pack(r, x);
+}
+
+#ifdef FULL_C25519_CODE
+void f25519_mul(uint8_t *r, const uint8_t *a, const uint8_t *b)
+{
+	f25519_mul__distinct(r, a, b);
+}
+#endif
+
+void f25519_mul_c(uint8_t *r, const uint8_t *a, uint32_t b)
+{
+	uint64_t x[5];
+
+	unpack(x, a);
+	fold(x, (u128)x[0] * b, (u128)x[1] * b, (u128)x[2] * b,
+	     (u128)x[3] * b, (u128)x[4] * b);
+	pack(r, x);
+}
+
+void f25519_inv__distinct(uint8_t *r, const uint8_t *x)
+{
+	uint64_t z[5], z11[5], t[5];
+
+	/* x^(p-2) = x^(2^255 - 21) = (x^(2^250 - 1))^(2^5) * x^11 */
+	unpack(z, x);
+	pow_2250(t, z11, z);
+	fsqr_n(t, t, 5);
+	fmul(t, t, z11);
+	pack(r, t);
+}
+
+#ifdef FULL_C25519_CODE
+void f25519_inv(uint8_t *r, const uint8_t *x)
+{
+	f25519_inv__distinct(r, x);
+}
+#endif
+
+void f25519_sqrt(uint8_t *r, const uint8_t *a)
+{
+	uint64_t x[5], v[5], i[5], t[5], z11[5];
+	int j;
+
+	/* v = (2a)^((p-5)/8) = (2a)^(2^252 - 3) [x = 2a] */
+	unpack(x, a);
+	for (j = 0; j < 5; j++)
+		x[j] *= 2;
+	carry(x);
+	pow_2250(t, z11, x);
+	fsqr_n(t, t, 2);
+	fmul(v, t, x);
+
+	/* i = 2av^2 - 1 */
+	fsqr(t, v);
+	fmul(i, x, t);
+	i[0] += P4_0 - 1;
+	for (j = 1; j < 5; j++)
+		i[j] += P4_N;
+	carry(i);
+
+	/* r = avi */
+	unpack(t, a);
+	fmul(t, t, v);
+	fmul(t, t, i);
+	pack(r, t);
+}
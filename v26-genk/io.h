@@ -0,0 +1,16 @@
+/* io.h - I/O backend interface.
+ *
+ * Exactly one backend is linked, picked by the Makefile's IO variable:
+ *   io_epoll.c  (IO=epoll, default) readiness + send/recv per socket
+ *   io_uring.c  (IO=uring)          batched submissions/completions
+ * Each one drives ssh_sess objects through the feed/drain API in ssh.h,
+ * and an exec channel's child through proc.h.
+ */
+#ifndef IO_H
+#define IO_H
+
+/* Serve every client accepted on the listening socket lfd (created
+ * non-blocking). Returns only on a fatal setup error. */
+int io_serve(int lfd);
+
+#endif /* IO_H */
@@ -0,0 +1,171 @@
+/* io_epoll.c - readiness-based I/O backend (the default, IO=epoll).
+ *
+ * One thread multiplexes every client through epoll and moves bytes
+ * between each socket and its ssh_sess. All per-connection state lives in
+ * a conn_t, so a slow or stalled peer only delays itself; the handshake
+ * rate is bounded by X25519/Ed25519 CPU time. Exec channels' pipes and
+ * pidfds join the same epoll set, tagged in the low bits of the conn_t
+ * pointer.
+ *
+ * Every fd leaves the set (EPOLL_CTL_DEL) before it is closed: a child
+ * forked but not yet exec'd holds copies of them all, and a registration
+ * lives as long as any copy does. A closed connection is only unmapped
+ * once the current batch of events is done, as later ones may name it.
+ *
+ * Out of fds (EMFILE/ENFILE), the listener stays readable but accept
+ * cannot take anything: it leaves the set until a connection closes, or
+ * ACCEPT_RETRY_MS passes for fds freed elsewhere (exec channels), so the
+ * pending clients wait in the backlog instead of spinning the loop. */
+
+#include <stdint.h>
+#include "nolibc.h"            /* sockets, epoll, mmap */
+#include "ssh.h"
+#include "proc.h"
+#include "io.h"
+
+#define MAX_EVENTS 64
+#define ACCEPT_RETRY_MS 1000
+
+/* One client. mmap'd on accept (zero-filled), munmap'd after the batch
+ * of events it was closed in. */
+typedef struct conn {
+    int fd;
+    uint32_t ev;                /* epoll events currently registered */
+    uint8_t dead;               /* closed, waiting to be unmapped */
+    struct conn *next;          /* on the dead list */
+    proc_t p[SSH_MAX_CHAN];         /* one child per channel (fd events
+                                     * registered in p[].wev) */
+    ssh_sess s;
+} conn_t;
+
+/* epoll tag: the (page aligned) conn_t | 0 for its socket,
+ * 1 + ch * P_NFD + i for p[ch].fd[i] */
+#define TAG_MASK 63
+
+static int epfd;
+static conn_t *dead;            /* closed in this batch */
+static uint32_t lev;            /* listener: EPOLLIN, 0 while out of fds */
+
+/* ---- registration follows what the session can use ----
+ * No events means not registered at all: a level-triggered HUP on a pipe
+ * we cannot drain yet would otherwise spin the loop. */
+static void watch(int fd, void *tag, uint32_t *cur, uint32_t ev) {
+    if (*cur == ev) return;
+    struct epoll_event e;
+    e.events = ev;
+    e.data.ptr = tag;
+    epoll_ctl(epfd, !ev ? EPOLL_CTL_DEL : *cur ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+              fd, &e);
+    *cur = ev;
+}
+
+void io_unwatch(proc_t *p, int i) {
+    watch(p->fd[i], 0, &p->wev[i], 0);
+}
+
+/* ---- write out as much pending output as the socket takes ----
+ * Returns -1 when the connection should be closed. */
+static int conn_flush(conn_t *c) {
+    const uint8_t *b;
+    size_t n;
+    uint32_t ev = 0;
+    while ((b = ssh_drain(&c->s, &n))) {
+        ssize_t r = send(c->fd, b, n, MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0 && errno == EAGAIN) {
+            ssh_drained(&c->s, 0);
+            ev = EPOLLOUT;
+            break;
+        }
+        if (r <= 0) return -1;
+        ssh_drained(&c->s, (size_t)r);
+    }
+    if (ssh_finished(&c->s)) return -1;
+    for (unsigned ch = 0; ch < SSH_MAX_CHAN; ch++) {
+        unsigned w = proc_wants(&c->p[ch], &c->s, ch);
+        for (int i = 0; i < P_NFD; i++)
+            watch(c->p[ch].fd[i], (uint8_t *)c + 1 + ch * P_NFD + i,
+                  &c->p[ch].wev[i],
+                  !(w >> i & 1) ? 0 : i == P_IN ? EPOLLOUT : EPOLLIN);
+        if (w >> P_RUN & 1) ev = EPOLLOUT;  /* fires at once, in turn */
+    }
+    /* no room once closing: input the loop would not read must not wake
+     * it while the last output waits for EPOLLOUT */
+    size_t room;
+    ssh_feed_buf(&c->s, &room);
+    watch(c->fd, c, &c->ev, (room ? EPOLLIN : 0) | ev);
+    return 0;
+}
+
+static int conn_read(conn_t *c) {
+    size_t room;
+    uint8_t *b = ssh_feed_buf(&c->s, &room);
+    if (!room) return 0;
+    ssize_t r = recv(c->fd, b, room, 0);
+    if (r < 0) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    if (r == 0) return -1;
+    return ssh_feed_done(&c->s, (size_t)r);
+}
+
+static void conn_close(conn_t *c) {
+    for (int ch = 0; ch < SSH_MAX_CHAN; ch++) proc_end(&c->p[ch]);
+    watch(c->fd, c, &c->ev, 0);
+    close(c->fd);
+    c->dead = 1;
+    c->next = dead;
+    dead = c;
+}
+
+/* ---- new client: banner + KEXINIT go out immediately ---- */
+static void conn_open(int fd) {
+    conn_t *c = mmap(0, sizeof(conn_t), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (c == MAP_FAILED) { close(fd); return; }
+    c->fd = fd;
+    if (ssh_init(&c->s) || conn_flush(c)) conn_close(c);
+}
+
+/* ---- the event loop: accept and serve clients until a fatal error ---- */
+int io_serve(int lfd) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) return 1;
+    struct epoll_event ev[MAX_EVENTS];
+    ev[0].events = EPOLLIN;
+    ev[0].data.ptr = 0;             /* NULL tag = the listening socket */
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev[0]) < 0) return 1;
+    lev = EPOLLIN;
+
+    for (;;) {
+        int n = epoll_wait(epfd, ev, MAX_EVENTS, lev ? -1 : ACCEPT_RETRY_MS);
+        for (int i = 0; i < n; i++) {
+            uintptr_t tag = (uintptr_t)ev[i].data.ptr;
+            conn_t *c = (conn_t *)(tag & ~(uintptr_t)TAG_MASK);
+            if (!c) {
+                int cfd;
+                while ((cfd = accept4(lfd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                    conn_open(cfd);
+                if (errno == EMFILE || errno == ENFILE)
+                    watch(lfd, 0, &lev, 0);
+                continue;
+            }
+            if (c->dead) continue;          /* closed earlier in this batch */
+            int bad = 0;
+            tag &= TAG_MASK;
+            if (!tag && ev[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                bad = conn_read(c);
+            if (!bad)
+                bad = !tag ? proc_pump_all(c->p, &c->s, SSH_MAX_CHAN, 0)
+                           : proc_pump_all(c->p, &c->s, (tag - 1) / P_NFD,
+                                           1u << (tag - 1) % P_NFD);
+            if (bad || conn_flush(c)) conn_close(c);
+        }
+        if (!lev && (dead || !n))       /* an fd freed, or time to retry */
+            watch(lfd, 0, &lev, EPOLLIN);
+        while (dead) {
+            conn_t *c = dead;
+            dead = c->next;
+            munmap(c, sizeof(*c));
+        }
+    }
+}
+
@@ -0,0 +1,280 @@
+/* io_uring.c - completion-based I/O backend (IO=uring).
+ *
+ * Every socket operation (accept, recv, send) is a submission queue entry.
+ * Entries for all connections pile up while a batch of completions is
+ * handled and go to the kernel in the same io_uring_enter() that waits for
+ * the next batch, so a handshake costs a handful of syscalls shared with
+ * every other busy connection instead of one per fragment. Exec
+ * channels' pipes and pidfds are one-shot POLL_ADDs in the same ring, the
+ * reads and writes themselves plain non-blocking syscalls (proc.c). Built
+ * on the raw io_uring_setup/io_uring_enter ABI in nolibc.h (no liburing).
+ *
+ * Accepting: one multishot ACCEPT completes once per client where the
+ * kernel has it (5.19+), else ACCEPT_DEPTH one-shot ones stay queued, so a
+ * login burst costs a few enters, not one each. A failed accept (EMFILE,
+ * ENFILE) is not re-armed, as it would only fail again at once: accepting
+ * resumes when a connection is freed, or after ACCEPT_RETRY_SEC for fds
+ * freed elsewhere (exec channels). */
+
+#include <stdint.h>
+#include "nolibc.h"            /* sockets, mmap, io_uring */
+#include "ssh.h"
+#include "proc.h"
+#include "io.h"
+
+#define RING_ENTRIES 1024       /* SQ size; the kernel makes the CQ 2x */
+#define ACCEPT_DEPTH 16         /* one-shot ACCEPTs kept queued */
+#define ACCEPT_RETRY_SEC 1
+
+static struct {
+    int fd;
+    uint32_t *sq_head, *sq_tail, *sq_array, sq_mask, sq_entries;
+    uint32_t *cq_head, *cq_tail, cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    uint32_t pending;           /* queued but not yet submitted */
+} ring;
+
+static struct {
+    int fd;                     /* the listener */
+    uint32_t q;                 /* ACCEPTs in flight */
+    uint8_t multi;              /* multishot, until the kernel says EINVAL */
+    uint8_t stall;              /* out of fds: wait for a close or the timer */
+    uint8_t timer;              /* retry TIMEOUT in flight */
+} acc;
+
+/* One client. mmap'd on accept (zero-filled), munmap'd on close. */
+typedef struct {
+    int fd;
+    uint8_t rxq, txq;           /* recv / send in flight */
+    uint8_t dead, shut;         /* closing; shutdown() issued to cut waits */
+    uint8_t runq;               /* NOP in flight: a channel can progress */
+    uint64_t pq;                /* bit ch * P_NFD + i: poll on p[ch].fd[i]
+                                 * in flight */
+    uint64_t prm;               /* of those, POLL_REMOVE already queued */
+    proc_t p[SSH_MAX_CHAN];     /* one child per channel */
+    ssh_sess s;
+} conn_t;
+
+/* user_data: conn_t pointer (page aligned) | operation; 0 is an accept,
+ * a bare OP_TIMER the accept retry, a bare OP_NONE a POLL_REMOVE whose
+ * completion is of no interest */
+#define OP_RECV 1
+#define OP_SEND 2
+#define OP_RUN 3                /* NOP: pump again after this batch */
+#define OP_POLL 4               /* + ch * P_NFD + fd slot, 4..43 */
+#define OP_TIMER 62
+#define OP_NONE 63
+#define OP_MASK 63
+
+static int ring_init(void) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring.fd = io_uring_setup(RING_ENTRIES, &p);
+    if (ring.fd < 0) return -1;
+    size_t sql = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    size_t cql = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && cql > sql) sql = cql;
+    uint8_t *sq = mmap(0, sql, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       ring.fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) return -1;
+    uint8_t *cq = single ? sq : mmap(0, cql, PROT_READ | PROT_WRITE,
+                                     MAP_SHARED, ring.fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) return -1;
+    ring.sqes = mmap(0, p.sq_entries * sizeof(struct io_uring_sqe),
+                     PROT_READ | PROT_WRITE, MAP_SHARED, ring.fd,
+                     IORING_OFF_SQES);
+    if (ring.sqes == MAP_FAILED) return -1;
+    ring.sq_head = (uint32_t *)(sq + p.sq_off.head);
+    ring.sq_tail = (uint32_t *)(sq + p.sq_off.tail);
+    ring.sq_array = (uint32_t *)(sq + p.sq_off.array);
+    ring.sq_mask = *(uint32_t *)(sq + p.sq_off.ring_mask);
+    ring.sq_entries = p.sq_entries;
+    ring.cq_head = (uint32_t *)(cq + p.cq_off.head);
+    ring.cq_tail = (uint32_t *)(cq + p.cq_off.tail);
+    ring.cq_mask = *(uint32_t *)(cq + p.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+/* Queue one operation. Nothing reaches the kernel until the next enter,
+ * unless the SQ is full, in which case the backlog is pushed out first;
+ * so the caller may still fill in the rarer fields of the entry returned. */
+static struct io_uring_sqe *sqe_push(uint8_t op, int fd, const void *addr,
+                                     size_t len, uint32_t op_flags,
+                                     uint64_t ud) {
+    uint32_t tail = *ring.sq_tail;
+    if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) == ring.sq_entries) {
+        int r = io_uring_enter(ring.fd, ring.pending, 0, 0);
+        if (r > 0) ring.pending -= (uint32_t)r;
+    }
+    struct io_uring_sqe *e = &ring.sqes[tail & ring.sq_mask];
+    memset(e, 0, sizeof(*e));
+    e->opcode = op;
+    e->fd = fd;
+    e->addr = (uint64_t)(uintptr_t)addr;
+    e->len = (uint32_t)len;
+    e->op_flags = op_flags;
+    e->user_data = ud;
+    ring.sq_array[tail & ring.sq_mask] = tail & ring.sq_mask;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring.pending++;
+    return e;
+}
+
+/* ---- keep accepting, unless out of fds ---- */
+static void accept_arm(void) {
+    if (acc.stall) return;
+    for (uint32_t n = acc.multi ? 1 : ACCEPT_DEPTH; acc.q < n; acc.q++)
+        sqe_push(IORING_OP_ACCEPT, acc.fd, 0, 0, SOCK_CLOEXEC, 0)->ioprio =
+            acc.multi ? IORING_ACCEPT_MULTISHOT : 0;
+}
+
+static void accept_stall(void) {
+    static const struct timespec retry = { ACCEPT_RETRY_SEC, 0 };
+    acc.stall = 1;
+    if (!acc.timer) {
+        sqe_push(IORING_OP_TIMEOUT, -1, &retry, 1, 0, OP_TIMER);
+        acc.timer = 1;
+    }
+}
+
+/* A poll holds its own reference to the file, and conn_kick() cancels
+ * it once the child is gone: nothing to undo before a close. */
+void io_unwatch(proc_t *p, int i) {
+    (void)p; (void)i;
+}
+
+/* ---- queue whatever the session can use next, or tear it down ---- */
+static void conn_kick(conn_t *c) {
+    const uint8_t *b;
+    size_t n;
+    if (!c->dead) {
+        if (!c->txq && (b = ssh_drain(&c->s, &n))) {
+            sqe_push(IORING_OP_SEND, c->fd, b, n, MSG_NOSIGNAL,
+                     (uint64_t)(uintptr_t)c | OP_SEND);
+            c->txq = 1;
+        }
+        if (ssh_finished(&c->s)) {
+            c->dead = 1;
+        } else if (!c->rxq) {
+            uint8_t *r = ssh_feed_buf(&c->s, &n);
+            if (n) {
+                sqe_push(IORING_OP_RECV, c->fd, r, n, 0,
+                         (uint64_t)(uintptr_t)c | OP_RECV);
+                c->rxq = 1;
+            }
+        }
+    }
+    /* polls follow proc_wants(); once a child is gone (or the connection)
+     * its polls are cancelled, as one may outlive it while a background
+     * job still holds the pipe and would hold up the slot's next child */
+    for (unsigned ch = 0; ch < SSH_MAX_CHAN; ch++) {
+        proc_t *p = &c->p[ch];
+        unsigned w = c->dead ? 0 : proc_wants(p, &c->s, ch);
+        if ((w >> P_RUN & 1) && !c->runq) {
+            sqe_push(IORING_OP_NOP, -1, 0, 0, 0, (uint64_t)(uintptr_t)c | OP_RUN);
+            c->runq = 1;
+        }
+        for (int i = 0; i < P_NFD; i++) {
+            unsigned op = ch * P_NFD + i;
+            uint64_t bit = 1ull << op;
+            if ((w >> i & 1) && !(c->pq & bit)) {
+                sqe_push(IORING_OP_POLL_ADD, p->fd[i], 0, 0,
+                         i == P_IN ? POLLOUT : POLLIN,
+                         (uint64_t)(uintptr_t)c | (OP_POLL + op));
+                c->pq |= bit;
+            } else if ((c->dead || !p->on) && (c->pq & ~c->prm & bit)) {
+                sqe_push(IORING_OP_POLL_REMOVE, -1,
+                         (void *)((uintptr_t)c | (OP_POLL + op)), 0, 0, OP_NONE);
+                c->prm |= bit;
+            }
+        }
+    }
+    if (!c->dead) return;
+    if (c->rxq || c->txq || c->pq || c->runq) {
+        /* the kernel still owns our buffers: make it give them back */
+        if (!c->shut) {
+            shutdown(c->fd, SHUT_RDWR);
+            c->shut = 1;
+        }
+        return;
+    }
+    for (int ch = 0; ch < SSH_MAX_CHAN; ch++) proc_end(&c->p[ch]);
+    close(c->fd);
+    munmap(c, sizeof(*c));
+    acc.stall = 0;                      /* an fd to accept into */
+    accept_arm();
+}
+
+static void conn_open(int fd) {
+    conn_t *c = mmap(0, sizeof(conn_t), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (c == MAP_FAILED) { close(fd); return; }
+    c->fd = fd;
+    if (ssh_init(&c->s)) c->dead = 1;
+    conn_kick(c);
+}
+
+static void on_cqe(uint64_t ud, int res, uint32_t flags) {
+    if (!ud) {
+        if (!(flags & IORING_CQE_F_MORE)) acc.q--;
+        if (res >= 0) conn_open(res);
+        else if (res == -EINVAL && acc.multi) acc.multi = 0;    /* < 5.19 */
+        else if (res == -EMFILE || res == -ENFILE) accept_stall();
+        accept_arm();
+        return;
+    }
+    if (ud == OP_TIMER) {
+        acc.timer = 0;
+        acc.stall = 0;
+        accept_arm();
+        return;
+    }
+    if (ud == OP_NONE) return;
+    conn_t *c = (conn_t *)(uintptr_t)(ud & ~(uint64_t)OP_MASK);
+    unsigned op = ud & OP_MASK, ch = SSH_MAX_CHAN, ready = 0;
+    if (op == OP_RECV) {
+        c->rxq = 0;
+        if (res <= 0 || ssh_feed_done(&c->s, (size_t)res)) c->dead = 1;
+    } else if (op == OP_SEND) {
+        c->txq = 0;
+        if (res < 0) c->dead = 1;
+        else ssh_drained(&c->s, (size_t)res);
+    } else if (op == OP_RUN) {
+        c->runq = 0;
+    } else {
+        op -= OP_POLL;
+        c->pq &= ~(1ull << op);
+        c->prm &= ~(1ull << op);
+        ch = op / P_NFD;
+        ready = 1u << op % P_NFD;
+    }
+    if (!c->dead && proc_pump_all(c->p, &c->s, ch, ready)) c->dead = 1;
+    conn_kick(c);
+}
+
+int io_serve(int lfd) {
+    if (ring_init()) return 1;
+    /* On an O_NONBLOCK file io_uring completes with -EAGAIN instead of
+     * waiting for readiness, so the listener and (via accept flags 0) every
+     * client socket are blocking here. */
+    fcntl(lfd, F_SETFL, fcntl(lfd, F_GETFL, 0) & ~O_NONBLOCK);
+    acc.fd = lfd;
+    acc.multi = 1;
+    accept_arm();
+
+    for (;;) {
+        int r = io_uring_enter(ring.fd, ring.pending, 1, IORING_ENTER_GETEVENTS);
+        if (r < 0) { if (errno == EINTR) continue; return 1; }
+        ring.pending -= (uint32_t)r;
+        uint32_t head = *ring.cq_head;
+        uint32_t tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *e = &ring.cqes[head & ring.cq_mask];
+            on_cqe(e->user_data, e->res, e->flags);
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+}
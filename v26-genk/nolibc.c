@@ -73,11 +73,6 @@ int strncmp(const char *a, const char *b, size_t n) {
 /* ------------------------------------------------------------------ */
 #define HEAP_SIZE (1u << 20)   /* 1 MiB arena, plenty for 35 KB packets */
 
-#define PROT_READ      0x1
-#define PROT_WRITE     0x2
-#define MAP_PRIVATE    0x02
-#define MAP_ANONYMOUS  0x20
-
 static unsigned char *heap_base = 0;
 static size_t heap_off = 0;
 static size_t heap_live = 0;   /* number of outstanding allocations */
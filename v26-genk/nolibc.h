@@ -24,7 +24,16 @@ typedef unsigned int  socklen_t;
 /* errno (simple global; not thread-safe but the server is single-thread) */
 /* ------------------------------------------------------------------ */
 extern int errno;
-#define EINTR 4
+#define EPERM  1
+#define ENOENT 2
+#define EINTR  4
+#define EAGAIN 11
+#define EACCES 13
+#define EINVAL 22
+#define ENFILE 23
+#define EMFILE 24
+#define EPIPE  32
+#define EINPROGRESS 115
 
 /* ------------------------------------------------------------------ */
 /* Raw syscall (x86-64 System V): syscall number in rax, args in       */
@@ -55,14 +64,54 @@ static inline long __syscall6(long n, long a1, long a2, long a3,
 #define SYS_write       1
 #define SYS_open        2
 #define SYS_close       3
+#define SYS_stat        4
+#define SYS_fstat       5
+#define SYS_lstat       6
+#define SYS_lseek       8
+#define SYS_rt_sigaction 13
 #define SYS_mmap        9
+#define SYS_munmap      11
+#define SYS_pread64     17
+#define SYS_pwrite64    18
+#define SYS_madvise     28
+#define SYS_dup2        33
 #define SYS_socket      41
+#define SYS_connect     42
 #define SYS_accept      43
+#define SYS_sendto      44
+#define SYS_shutdown    48
 #define SYS_bind        49
 #define SYS_listen      50
 #define SYS_setsockopt  54
+#define SYS_getsockopt  55
+#define SYS_getpid      39
+#define SYS_fork        57
+#define SYS_execve      59
+#define SYS_wait4       61
+#define SYS_kill        62
+#define SYS_fcntl       72
+#define SYS_getcwd      79
+#define SYS_rename      82
+#define SYS_mkdir       83
+#define SYS_rmdir       84
+#define SYS_unlink      87
+#define SYS_prctl       157
+#define SYS_sched_setaffinity 203
+#define SYS_sched_getaffinity 204
+#define SYS_getdents64  217
+#define SYS_clock_gettime 228
 #define SYS_exit_group  231
+#define SYS_epoll_wait  232
+#define SYS_epoll_ctl   233
+#define SYS_newfstatat  262
+#define SYS_accept4     288
+#define SYS_epoll_create1 291
+#define SYS_pipe2       293
+#define SYS_prlimit64   302
 #define SYS_getrandom   318
+#define SYS_io_uring_setup 425
+#define SYS_io_uring_enter 426
+#define SYS_pidfd_open  434
 
 /* ------------------------------------------------------------------ */
 /* errno-translating wrapper: kernel returns -errno on failure.        */
@@ -78,15 +127,90 @@ static inline long __sysret(long r) {
 /* ------------------------------------------------------------------ */
 /* exit                                                                */
 /* ------------------------------------------------------------------ */
-static inline void _exit_group(int code) {
+__attribute__((noreturn)) static inline void _exit_group(int code) {
     __syscall1(SYS_exit_group, code);
     __builtin_unreachable();
 }
 
+/* ------------------------------------------------------------------ */
+/* Processes                                                           */
+/* ------------------------------------------------------------------ */
+#define SIGKILL           9
+#define SIGPIPE           13
+#define SIG_DFL           0
+#define SIG_IGN           1
+#define PR_SET_PDEATHSIG  1
+#define WNOHANG           1
+#define WIFEXITED(s)      (((s) & 0x7f) == 0)
+#define WEXITSTATUS(s)    (((s) >> 8) & 0xff)
+#define WIFSIGNALED(s)    (((s) & 0x7f) != 0 && ((s) & 0x7f) != 0x7f)
+#define WTERMSIG(s)       ((s) & 0x7f)
+#define WCOREDUMP(s)      ((s) & 0x80)
+
+/* No atfork handlers or cached pid to fix up, so the raw syscall is the
+ * whole of fork(). */
+static inline int fork(void) {
+    return (int)__sysret(__syscall0(SYS_fork));
+}
+static inline int wait4(int pid, int *status, int options, void *rusage) {
+    return (int)__sysret(__syscall4(SYS_wait4, pid, status, options, rusage));
+}
+static inline int prctl(int op, long arg) {
+    return (int)__sysret(__syscall2(SYS_prctl, op, arg));
+}
+static inline int getpid(void) {
+    return (int)__syscall0(SYS_getpid);
+}
+static inline int execve(const char *path, char *const argv[],
+                         char *const envp[]) {
+    return (int)__sysret(__syscall3(SYS_execve, path, argv, envp));
+}
+static inline int kill(int pid, int sig) {
+    return (int)__sysret(__syscall2(SYS_kill, pid, sig));
+}
+/* pollable (readable once the child exits), close-on-exec; Linux >= 5.3 */
+static inline int pidfd_open(int pid, unsigned flags) {
+    return (int)__sysret(__syscall2(SYS_pidfd_open, pid, flags));
+}
+
+/* Only SIG_IGN / SIG_DFL: with no handler there is nothing to return
+ * through, so the kernel needs no sa_restorer. */
+static inline int signal(int sig, unsigned long disp) {
+    unsigned long act[4] = { disp, 0, 0, 0 };   /* handler, flags, restorer, mask */
+    return (int)__sysret(__syscall4(SYS_rt_sigaction, sig, act, 0, 8));
+}
+
+/* CPU affinity masks as plain 64-bit words (1024 CPUs). */
+#define CPU_WORDS 16
+static inline int sched_getaffinity(int pid, size_t len, uint64_t *mask) {
+    return (int)__sysret(__syscall3(SYS_sched_getaffinity, pid, len, mask));
+}
+static inline int sched_setaffinity(int pid, size_t len, const uint64_t *mask) {
+    return (int)__sysret(__syscall3(SYS_sched_setaffinity, pid, len, mask));
+}
+
+/* Resource limits of this process, both ways through prlimit64(2). */
+#define RLIMIT_NOFILE 7
+struct rlimit { uint64_t rlim_cur, rlim_max; };
+static inline int getrlimit(int res, struct rlimit *rl) {
+    return (int)__sysret(__syscall4(SYS_prlimit64, 0, res, 0, rl));
+}
+static inline int setrlimit(int res, const struct rlimit *rl) {
+    return (int)__sysret(__syscall4(SYS_prlimit64, 0, res, rl, 0));
+}
+
 /* ------------------------------------------------------------------ */
 /* File / fd I/O                                                       */
 /* ------------------------------------------------------------------ */
-#define O_RDONLY 0
+#define O_RDONLY    0
+#define O_WRONLY    1
+#define O_RDWR      2
+#define O_CREAT     0100
+#define O_EXCL      0200
+#define O_TRUNC     01000
+#define O_APPEND    02000
+#define O_DIRECTORY 0200000
+#define O_CLOEXEC   02000000
 
 static inline ssize_t read(int fd, void *buf, size_t n) {
     return __sysret(__syscall3(SYS_read, fd, buf, n));
@@ -97,8 +221,127 @@ static inline ssize_t write(int fd, const void *buf, size_t n) {
 static inline int close(int fd) {
     return (int)__sysret(__syscall1(SYS_close, fd));
 }
-static inline int open(const char *path, int flags) {
-    return (int)__sysret(__syscall3(SYS_open, path, flags, 0));
+static inline int open(const char *path, int flags, int mode) {
+    return (int)__sysret(__syscall3(SYS_open, path, flags, mode));
+}
+static inline int pipe2(int fd[2], int flags) {
+    return (int)__sysret(__syscall2(SYS_pipe2, fd, flags));
+}
+static inline int dup2(int fd, int to) {
+    return (int)__sysret(__syscall2(SYS_dup2, fd, to));
+}
+static inline ssize_t pread(int fd, void *buf, size_t n, long off) {
+    return __sysret(__syscall4(SYS_pread64, fd, buf, n, off));
+}
+static inline ssize_t pwrite(int fd, const void *buf, size_t n, long off) {
+    return __sysret(__syscall4(SYS_pwrite64, fd, buf, n, off));
+}
+#define SEEK_SET 0
+static inline long lseek(int fd, long off, int whence) {
+    return __sysret(__syscall3(SYS_lseek, fd, off, whence));
+}
+
+#define F_GETFL    3
+#define F_SETFL    4
+#define O_NONBLOCK 04000
+#define F_DUPFD_CLOEXEC 1030
+#define F_SETPIPE_SZ 1031
+
+static inline int fcntl(int fd, int cmd, long arg) {
+    return (int)__sysret(__syscall3(SYS_fcntl, fd, cmd, arg));
+}
+
+/* ------------------------------------------------------------------ */
+/* Files and directories                                               */
+/* ------------------------------------------------------------------ */
+#define S_IFMT   0170000
+#define S_IFDIR  0040000
+#define S_IFLNK  0120000
+#define AT_SYMLINK_NOFOLLOW 0x100
+
+/* x86-64 kernel struct stat */
+struct stat {
+    unsigned long st_dev, st_ino, st_nlink;
+    unsigned int  st_mode, st_uid, st_gid, __pad0;
+    unsigned long st_rdev;
+    long          st_size, st_blksize, st_blocks;
+    unsigned long st_atime, st_atime_nsec, st_mtime, st_mtime_nsec;
+    unsigned long st_ctime, st_ctime_nsec;
+    long          __unused[3];
+};
+
+/* getdents64() record; d_off is where the next one starts (for lseek) */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t  d_off;
+    uint16_t d_reclen;
+    uint8_t  d_type;
+    char     d_name[];
+};
+
+static inline int stat(const char *path, struct stat *st) {
+    return (int)__sysret(__syscall2(SYS_stat, path, st));
+}
+static inline int lstat(const char *path, struct stat *st) {
+    return (int)__sysret(__syscall2(SYS_lstat, path, st));
+}
+static inline int fstat(int fd, struct stat *st) {
+    return (int)__sysret(__syscall2(SYS_fstat, fd, st));
+}
+static inline int fstatat(int dfd, const char *path, struct stat *st, int flags) {
+    return (int)__sysret(__syscall4(SYS_newfstatat, dfd, path, st, flags));
+}
+static inline long getdents64(int fd, void *buf, size_t n) {
+    return __sysret(__syscall3(SYS_getdents64, fd, buf, n));
+}
+static inline int mkdir(const char *path, int mode) {
+    return (int)__sysret(__syscall2(SYS_mkdir, path, mode));
+}
+static inline int rmdir(const char *path) {
+    return (int)__sysret(__syscall1(SYS_rmdir, path));
+}
+static inline int unlink(const char *path) {
+    return (int)__sysret(__syscall1(SYS_unlink, path));
+}
+static inline int rename(const char *from, const char *to) {
+    return (int)__sysret(__syscall2(SYS_rename, from, to));
+}
+/* returns the length including the NUL, unlike libc */
+static inline long getcwd(char *buf, size_t n) {
+    return __sysret(__syscall2(SYS_getcwd, buf, n));
+}
+
+/* ------------------------------------------------------------------ */
+/* Memory mapping                                                      */
+/* ------------------------------------------------------------------ */
+#define PROT_READ      0x1
+#define PROT_WRITE     0x2
+#define MAP_SHARED     0x01
+#define MAP_PRIVATE    0x02
+#define MAP_ANONYMOUS  0x20
+#define MAP_FAILED     ((void *)-1)
+
+static inline void *mmap(void *addr, size_t len, int prot, int flags,
+                         int fd, long off) {
+    return (void *)__sysret(__syscall6(SYS_mmap, (long)addr, (long)len,
+                                       prot, flags, fd, off));
+}
+static inline int munmap(void *addr, size_t len) {
+    return (int)__sysret(__syscall2(SYS_munmap, addr, len));
+}
+
+#define MADV_WIPEONFORK 18      /* child sees the range zero-filled */
+static inline int madvise(void *addr, size_t len, int advice) {
+    return (int)__sysret(__syscall3(SYS_madvise, addr, len, advice));
+}
+
+/* ------------------------------------------------------------------ */
+/* Time (raw syscall: no vDSO without libc)                            */
+/* ------------------------------------------------------------------ */
+#define CLOCK_MONOTONIC 1
+struct timespec { long tv_sec; long tv_nsec; };
+static inline int clock_gettime(int clk, struct timespec *ts) {
+    return (int)__sysret(__syscall2(SYS_clock_gettime, clk, ts));
 }
 
 /* ------------------------------------------------------------------ */
@@ -107,7 +350,14 @@ static inline int open(const char *path, int flags) {
 #define AF_INET        2
 #define SOCK_STREAM    1
 #define SOL_SOCKET     1
+#define SOCK_NONBLOCK  04000
+#define SOCK_CLOEXEC   02000000
 #define SO_REUSEADDR   2
+#define SO_ERROR       4
+#define SO_REUSEPORT   15
+#define IPPROTO_TCP    6
+#define TCP_NODELAY    1
+#define MSG_NOSIGNAL   0x4000
 #define INADDR_ANY     ((uint32_t)0x00000000)
 
 struct sockaddr {
@@ -132,28 +382,152 @@ static inline int socket(int domain, int type, int protocol) {
 static inline int bind(int fd, const struct sockaddr *addr, socklen_t len) {
     return (int)__sysret(__syscall3(SYS_bind, fd, addr, len));
 }
+static inline int connect(int fd, const struct sockaddr *addr, socklen_t len) {
+    return (int)__sysret(__syscall3(SYS_connect, fd, addr, len));
+}
 static inline int listen(int fd, int backlog) {
     return (int)__sysret(__syscall2(SYS_listen, fd, backlog));
 }
 static inline int accept(int fd, struct sockaddr *addr, socklen_t *len) {
     return (int)__sysret(__syscall3(SYS_accept, fd, addr, len));
 }
+static inline int accept4(int fd, struct sockaddr *addr, socklen_t *len,
+                          int flags) {
+    return (int)__sysret(__syscall4(SYS_accept4, fd, addr, len, flags));
+}
 static inline int setsockopt(int fd, int level, int optname,
                              const void *optval, socklen_t optlen) {
     return (int)__sysret(__syscall5(SYS_setsockopt, fd, level, optname,
                                     optval, optlen));
 }
+static inline int getsockopt(int fd, int level, int optname,
+                             void *optval, socklen_t *optlen) {
+    return (int)__sysret(__syscall5(SYS_getsockopt, fd, level, optname,
+                                    optval, optlen));
+}
+
+#define SHUT_WR   1
+#define SHUT_RDWR 2
+static inline int shutdown(int fd, int how) {
+    return (int)__sysret(__syscall2(SYS_shutdown, fd, how));
+}
 
-/* send/recv are just write/read for a connected TCP socket (flags=0). */
+/* send goes through sendto so flags (MSG_NOSIGNAL) are honoured: with many
+ * clients on one process a peer reset must not raise SIGPIPE. recv is just
+ * read for a connected TCP socket (flags=0). */
 static inline ssize_t send(int fd, const void *buf, size_t n, int flags) {
-    (void)flags;
-    return write(fd, buf, n);
+    return __sysret(__syscall6(SYS_sendto, fd, (long)buf, (long)n, flags, 0, 0));
 }
 static inline ssize_t recv(int fd, void *buf, size_t n, int flags) {
     (void)flags;
     return read(fd, buf, n);
 }
 
+/* ------------------------------------------------------------------ */
+/* epoll                                                               */
+/* ------------------------------------------------------------------ */
+#define EPOLLIN        0x001
+#define EPOLLOUT       0x004
+#define EPOLLERR       0x008
+#define EPOLLHUP       0x010
+#define EPOLL_CLOEXEC  02000000
+#define EPOLL_CTL_ADD  1
+#define EPOLL_CTL_DEL  2
+#define EPOLL_CTL_MOD  3
+
+typedef union epoll_data {
+    void    *ptr;
+    int      fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+/* The x86-64 kernel ABI packs this struct (12 bytes, no padding). */
+struct epoll_event {
+    uint32_t     events;
+    epoll_data_t data;
+} __attribute__((packed));
+
+static inline int epoll_create1(int flags) {
+    return (int)__sysret(__syscall1(SYS_epoll_create1, flags));
+}
+static inline int epoll_ctl(int ep, int op, int fd, struct epoll_event *ev) {
+    return (int)__sysret(__syscall4(SYS_epoll_ctl, ep, op, fd, ev));
+}
+static inline int epoll_wait(int ep, struct epoll_event *evs, int max,
+                             int timeout) {
+    return (int)__sysret(__syscall4(SYS_epoll_wait, ep, evs, max, timeout));
+}
+
+/* ------------------------------------------------------------------ */
+/* io_uring (raw kernel ABI, no liburing)                              */
+/* ------------------------------------------------------------------ */
+#define IORING_OFF_SQ_RING    0ULL
+#define IORING_OFF_CQ_RING    0x8000000ULL
+#define IORING_OFF_SQES       0x10000000ULL
+#define IORING_FEAT_SINGLE_MMAP (1u << 0)
+#define IORING_ENTER_GETEVENTS  (1u << 0)
+
+#define IORING_OP_NOP         0
+#define IORING_OP_POLL_ADD    6
+#define IORING_OP_POLL_REMOVE 7
+#define POLLIN                0x001   /* poll32_events for POLL_ADD */
+#define POLLOUT               0x004
+#define IORING_OP_TIMEOUT     11    /* addr: struct timespec, len 1 */
+#define IORING_OP_ACCEPT      13
+#define IORING_ACCEPT_MULTISHOT (1u << 0)   /* in ioprio; Linux >= 5.19 */
+#define IORING_CQE_F_MORE     (1u << 1)     /* multishot: more will follow */
+#define IORING_OP_SEND        26
+#define IORING_OP_RECV        27
+
+struct io_sqring_offsets {
+    uint32_t head, tail, ring_mask, ring_entries, flags, dropped, array;
+    uint32_t resv1;
+    uint64_t user_addr;
+};
+
+struct io_cqring_offsets {
+    uint32_t head, tail, ring_mask, ring_entries, overflow, cqes, flags;
+    uint32_t resv1;
+    uint64_t user_addr;
+};
+
+struct io_uring_params {
+    uint32_t sq_entries, cq_entries, flags, sq_thread_cpu, sq_thread_idle;
+    uint32_t features, wq_fd, resv[3];
+    struct io_sqring_offsets sq_off;
+    struct io_cqring_offsets cq_off;
+};
+
+/* 64-byte submission entry; op_flags is the per-opcode flags union
+ * (msg_flags, accept_flags, poll32_events, ...). */
+struct io_uring_sqe {
+    uint8_t  opcode, flags;
+    uint16_t ioprio;
+    int32_t  fd;
+    uint64_t off, addr;
+    uint32_t len, op_flags;
+    uint64_t user_data;
+    uint16_t buf_index, personality;
+    int32_t  splice_fd_in;
+    uint64_t addr3, pad2;
+};
+
+struct io_uring_cqe {
+    uint64_t user_data;
+    int32_t  res;
+    uint32_t flags;
+};
+
+static inline int io_uring_setup(uint32_t entries, struct io_uring_params *p) {
+    return (int)__sysret(__syscall2(SYS_io_uring_setup, entries, p));
+}
+static inline int io_uring_enter(int fd, uint32_t to_submit,
+                                 uint32_t min_complete, uint32_t flags) {
+    return (int)__sysret(__syscall6(SYS_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, 0, 0));
+}
+
 /* host-to-network short (x86-64 is little-endian) */
 static inline uint16_t htons(uint16_t x) {
     return (uint16_t)((x << 8) | (x >> 8));
@@ -0,0 +1,271 @@
+/* proc.c - the child process behind an exec channel (see proc.h). */
+
+#include <stdint.h>
+#include "nolibc.h"            /* pipes, fork/execve, wait4, pidfd, sockets */
+#include "proc.h"
+
+#define PIPE_SZ (4 * SSH_CHAN_PKT)  /* fewer, fuller reads and writes */
+
+static uint64_t cpus[CPU_WORDS];    /* children's CPUs, if cpus_set */
+static int cpus_set;
+
+void proc_cpus(const uint64_t *mask) {
+    memcpy(cpus, mask, sizeof(cpus));
+    cpus_set = 1;
+}
+
+/* ---- fork "/bin/sh -c cmd" with stdin/stdout/stderr on pipes ----
+ * Our ends are non-blocking and close-on-exec (so no later child inherits
+ * them); the child's are plain blocking stdio. SIGPIPE is ignored here so
+ * a child that stops reading costs a write EPIPE, not the server; the
+ * child puts the default back, as an ignored signal survives exec, and
+ * leaves a pool worker's CPU (see proc_cpus()). */
+static int proc_start(proc_t *p, const char *cmd) {
+    static char *const env[] = { "PATH=/usr/local/bin:/usr/bin:/bin", 0 };
+    int pp[3][2], n, pid = -1;
+    for (n = 0; n < 3; n++)
+        if (pipe2(pp[n], O_CLOEXEC) < 0) break;
+    if (n == 3) {
+        signal(SIGPIPE, SIG_IGN);
+        pid = fork();
+    }
+    if (!pid) {
+        char *const argv[] = { "sh", "-c", (char *)cmd, 0 };
+        dup2(pp[0][0], 0); dup2(pp[1][1], 1); dup2(pp[2][1], 2);
+        signal(SIGPIPE, SIG_DFL);
+        if (cpus_set) sched_setaffinity(0, sizeof(cpus), cpus);
+        execve("/bin/sh", argv, env);
+        _exit_group(127);
+    }
+    while (n--) {
+        int mine = pp[n][n == P_IN], theirs = pp[n][n != P_IN];
+        close(theirs);
+        if (pid < 0) { close(mine); continue; }
+        fcntl(mine, F_SETFL, O_NONBLOCK);
+        if (n != P_ERR) fcntl(mine, F_SETPIPE_SZ, PIPE_SZ);
+        p->fd[n] = mine;
+    }
+    if (pid < 0) return -1;
+    p->pid = pid;
+    p->reaped = 0;
+    p->fd[P_PID] = pidfd_open(pid, 0);
+    p->on = 1;
+    return 0;
+}
+
+/* ---- close our end fd[i], once the backend has let go of it ---- */
+static void proc_close(proc_t *p, int i) {
+    io_unwatch(p, i);
+    close(p->fd[i]);
+    p->fd[i] = -1;
+}
+
+/* ---- direct-tcpip: a non-blocking connect() to host:port ----
+ * There is no resolver, so host must be a dotted IPv4 address or
+ * "localhost". The socket stands in for both pipes: fd[P_IN] to send the
+ * client's data, a dup of it as fd[P_OUT] to read the reply, so either
+ * backend can wait on each direction by itself.
+ * Only loopback (127.0.0.0/8) is reachable unless built with FWD_ANY=1
+ * (-DNANO_FWD_ANY), so the password alone is no relay into the server's
+ * network; other addresses fail as a connect would. */
+static int fwd_addr(const char *h, uint32_t *a) {
+    if (!strcmp(h, "localhost")) h = "127.0.0.1";
+    uint8_t *o = (uint8_t *)a;          /* network byte order */
+    for (int i = 0; i < 4; i++) {
+        unsigned v = 0, d = 0;
+        for (; *h >= '0' && *h <= '9' && d < 3; d++) v = v * 10 + (*h++ - '0');
+        if (!d || v > 255 || *h != (i < 3 ? '.' : 0)) return -1;
+        o[i] = (uint8_t)v;
+        h += i < 3;
+    }
+    return 0;
+}
+
+static int fwd_start(proc_t *p, const char *host, int port) {
+    struct sockaddr_in a;
+    int one = 1;
+    memset(&a, 0, sizeof(a));
+    a.sin_family = AF_INET;
+    a.sin_port = htons((uint16_t)port);
+    if (fwd_addr(host, &a.sin_addr.s_addr)) return -1;
+#ifndef NANO_FWD_ANY
+    if (((uint8_t *)&a.sin_addr.s_addr)[0] != 127) return -1;
+#endif
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0 &&
+        errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    for (int i = 0; i < P_NFD; i++) p->fd[i] = -1;
+    p->fd[P_IN] = fd;
+    p->pid = 0;
+    p->reaped = 1;                      /* nothing to wait for */
+    p->fwd = 1;
+    p->shut = 0;
+    p->on = 1;
+    return 0;
+}
+
+/* A forwarding relays both ways until each side has sent its EOF. The
+ * socket stays open until then: closing one of two fds on it would leave
+ * its epoll registration live under the other. */
+static int fwd_pump(proc_t *p, ssh_sess *s, unsigned ch, unsigned ready) {
+    if (ssh_chan_gone(s, ch)) {                        /* client closed it */
+        proc_end(p);
+        return ssh_chan_exit(s, ch, 0);
+    }
+    if (p->fwd == 1) {                  /* connect() done once writable */
+        int err = 0;
+        socklen_t l = sizeof(err);
+        if (!(ready >> P_IN & 1)) return 0;
+        if (getsockopt(p->fd[P_IN], SOL_SOCKET, SO_ERROR, &err, &l) < 0 ||
+            err || (p->fd[P_OUT] = fcntl(p->fd[P_IN], F_DUPFD_CLOEXEC, 0)) < 0) {
+            proc_end(p);
+            return ssh_chan_confirm(s, ch, 0);
+        }
+        p->fwd = 2;
+        return ssh_chan_confirm(s, ch, 1);
+    }
+
+    /* reply: one packet per readiness event, like a child's stdout */
+    size_t room;
+    uint8_t *o;
+    if (!(p->shut >> P_OUT & 1) && (ready >> P_OUT & 1) &&
+        (o = ssh_chan_out(s, ch, 0, &room), room)) {
+        ssize_t r = read(p->fd[P_OUT], o, room);
+        if (r > 0) ssh_chan_sent(s, ch, 0, (size_t)r);
+        else if (!r || (errno != EAGAIN && errno != EINTR)) {
+            p->shut |= 1u << P_OUT;
+            ssh_chan_eof(s, ch);
+        }
+    }
+
+    /* client data; dropped once the peer stops taking it */
+    const uint8_t *b;
+    size_t n;
+    while ((b = ssh_chan_in(s, ch, &n))) {
+        ssize_t r = n;
+        if (!(p->shut >> P_IN & 1)) {
+            r = send(p->fd[P_IN], b, n, MSG_NOSIGNAL);
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && errno == EAGAIN) break;
+            if (r < 0) { p->shut |= 1u << P_IN; continue; }
+        }
+        if (ssh_chan_taken(s, ch, (size_t)r)) return -1;
+    }
+    if (!(p->shut >> P_IN & 1) && ssh_chan_ieof(s, ch)) {
+        shutdown(p->fd[P_IN], SHUT_WR);
+        p->shut |= 1u << P_IN;
+    }
+    if (p->shut != (1u << P_IN | 1u << P_OUT)) return 0;
+    proc_end(p);
+    return ssh_chan_exit(s, ch, 0);
+}
+
+int proc_pump(proc_t *p, ssh_sess *s, unsigned ch, unsigned ready) {
+    const char *cmd = ssh_chan_cmd(s, ch);
+    int kind = ssh_chan_kind(s, ch);
+    if (cmd && kind == SSH_CHAN_TCP && fwd_start(p, cmd, ssh_chan_port(s, ch)))
+        return ssh_chan_confirm(s, ch, 0);
+    if (cmd && (kind == SSH_CHAN_SFTP ? !(p->sftp = sftp_new())
+              : kind == SSH_CHAN_EXEC && proc_start(p, cmd) < 0))
+        return ssh_chan_exit(s, ch, 127 << 8);
+    if (p->sftp) {                     /* until the client's EOF or CLOSE */
+        int r = 0;
+        if (!ssh_chan_gone(s, ch) && !ssh_chan_ieof(s, ch) &&
+            (r = sftp_pump(p->sftp, s, ch)) <= 0) return r;
+        sftp_free(p->sftp);
+        p->sftp = 0;
+        return ssh_chan_exit(s, ch, r << 8);
+    }
+    if (!p->on) return 0;
+    if (p->fwd) return fwd_pump(p, s, ch, ready);
+    if (ssh_chan_gone(s, ch)) {                        /* client closed it */
+        proc_end(p);
+        return ssh_chan_exit(s, ch, 0);
+    }
+
+    /* stdout / stderr: one packet each, straight into tx; the next waits
+     * for the next readiness event, behind the other channels' */
+    for (int i = P_OUT; i <= P_ERR; i++) {
+        while (p->fd[i] >= 0 && (ready >> i & 1)) {
+            size_t room;
+            uint8_t *b = ssh_chan_out(s, ch, i == P_ERR, &room);
+            if (!room) break;
+            ssize_t r = read(p->fd[i], b, room);
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && errno == EAGAIN) break;
+            if (r <= 0) { proc_close(p, i); break; }
+            ssh_chan_sent(s, ch, i == P_ERR, (size_t)r);
+            break;
+        }
+    }
+
+    /* stdin: whatever the client sent, in place; dropped once nobody reads */
+    const uint8_t *b;
+    size_t n;
+    while ((b = ssh_chan_in(s, ch, &n))) {
+        ssize_t r = n;
+        if (p->fd[P_IN] >= 0) {
+            r = write(p->fd[P_IN], b, n);
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0 && errno == EAGAIN) break;
+            if (r < 0) { proc_close(p, P_IN); continue; }
+        }
+        if (ssh_chan_taken(s, ch, (size_t)r)) return -1;
+    }
+    if (p->fd[P_IN] >= 0 && ssh_chan_ieof(s, ch)) proc_close(p, P_IN);
+
+    /* exit: reported only after both pipes reached EOF. Without a pidfd
+     * (kernel < 5.3) the child is waited for once they have. */
+    int eof = p->fd[P_OUT] < 0 && p->fd[P_ERR] < 0;
+    int pidfd = p->fd[P_PID] >= 0;
+    if (!p->reaped && (pidfd ? (ready >> P_PID & 1) != 0 : eof) &&
+        wait4(p->pid, &p->status, pidfd ? WNOHANG : 0, 0) == p->pid) {
+        p->reaped = 1;
+        if (pidfd) proc_close(p, P_PID);
+    }
+    if (p->reaped && eof) {
+        if (p->fd[P_IN] >= 0) proc_close(p, P_IN);
+        p->on = 0;
+        return ssh_chan_exit(s, ch, p->status);
+    }
+    return 0;
+}
+
+int proc_pump_all(proc_t *p, ssh_sess *s, unsigned rch, unsigned ready) {
+    for (unsigned ch = 0; ch < SSH_MAX_CHAN; ch++)
+        if (proc_pump(&p[ch], s, ch, ch == rch ? ready : 0)) return -1;
+    return 0;
+}
+
+unsigned proc_wants(proc_t *p, ssh_sess *s, unsigned ch) {
+    if (p->sftp) return sftp_ready(p->sftp, s, ch) ? 1u << P_RUN : 0;
+    if (!p->on) return 0;
+    if (p->fwd == 1) return 1u << P_IN;                /* connecting */
+    unsigned w = 0, open = ~(unsigned)p->shut;
+    size_t room;
+    for (int i = P_OUT; i <= P_ERR; i++)
+        if (p->fd[i] >= 0 && (open >> i & 1) &&
+            (ssh_chan_out(s, ch, i == P_ERR, &room), room))
+            w |= 1u << i;
+    if (p->fd[P_IN] >= 0 && (open >> P_IN & 1) && ssh_chan_in(s, ch, &room))
+        w |= 1u << P_IN;
+    if (p->fd[P_PID] >= 0) w |= 1u << P_PID;
+    return w;
+}
+
+void proc_end(proc_t *p) {
+    if (p->sftp) { sftp_free(p->sftp); p->sftp = 0; }
+    if (!p->on) return;
+    if (!p->reaped) {
+        kill(p->pid, SIGKILL);
+        wait4(p->pid, 0, 0, 0);
+    }
+    for (int i = 0; i < P_NFD; i++)
+        if (p->fd[i] >= 0) proc_close(p, i);
+    p->on = p->fwd = 0;
+}
@@ -0,0 +1,67 @@
+/* proc.h - the child process behind an exec channel (or, for the sftp
+ * subsystem, the in-process server standing in for one; for a direct-tcpip
+ * forwarding, the TCP connection it relays).
+ *
+ * Shared by both I/O backends: proc_pump() does every non-blocking step
+ * the session allows (start the command it asked for, read the child's
+ * stdout/stderr straight into channel packets, write held client data to
+ * its stdin, reap it, report the exit), and proc_wants() says which fds
+ * are worth waiting on. The backend keeps one proc_t per channel index,
+ * maps their fds onto epoll or io_uring polls and calls proc_pump() again
+ * when one fires.
+ *
+ * Output is read one packet per fd per readiness event. Ready fds of all
+ * channels come back from epoll (level-triggered) or the ring (one-shot,
+ * re-armed) in turn, so the output queue is shared round-robin at packet
+ * granularity: a bulk channel cannot starve an interactive one.
+ */
+#ifndef PROC_H
+#define PROC_H
+
+#include "ssh.h"
+#include "sftp.h"
+
+/* fd[] slots; a backend waits for P_IN to be writable, the rest readable.
+ * P_PID is a pidfd, readable once the child has exited. P_RUN is no fd:
+ * the channel can make progress now, so pump it again (after giving other
+ * connections a turn) until proc_wants() drops it. */
+enum { P_IN, P_OUT, P_ERR, P_PID, P_NFD, P_RUN = P_NFD };
+
+/* Zero-filled until a command starts (fd[] is only valid while on). */
+typedef struct {
+    int pid, status;
+    int fd[P_NFD];              /* our ends; -1 once closed */
+    uint8_t on;                 /* child started */
+    uint8_t reaped;             /* status valid */
+    uint8_t fwd;                /* direct-tcpip: 1 connecting, 2 relaying */
+    uint8_t shut;               /* fwd: bit P_IN / P_OUT once that way hit EOF */
+    uint32_t wev[P_NFD];        /* backend's registration of fd[i], if any */
+    sftp_t *sftp;               /* subsystem served in process, no child */
+} proc_t;
+
+/* Run what channel ch needs; ready has bit i set if fd[i] fired. Returns
+ * -1 if the transport should be dropped. */
+int proc_pump(proc_t *p, ssh_sess *s, unsigned ch, unsigned ready);
+
+/* proc_pump() on every channel, with the fired fds (if any) on channel
+ * rch. p is the backend's proc_t[SSH_MAX_CHAN]. */
+int proc_pump_all(proc_t *p, ssh_sess *s, unsigned rch, unsigned ready);
+
+/* Bit i set: wait on fd[i] before the next proc_pump(). */
+unsigned proc_wants(proc_t *p, ssh_sess *s, unsigned ch);
+
+/* Channel or connection gone: kill and reap the child, close our ends. */
+void proc_end(proc_t *p);
+
+/* CPUs a command may run on. A pool worker is pinned to one CPU; it
+ * passes the mask it had before that, so its commands are not confined to
+ * its core and kept off the others. Until called, children inherit the
+ * server's own mask. */
+void proc_cpus(const uint64_t *mask);
+
+/* Supplied by the backend: fd[i] is about to be closed. A child forked
+ * for another channel may still hold a copy, so closing alone does not
+ * take it out of an epoll set. */
+void io_unwatch(proc_t *p, int i);
+
+#endif /* PROC_H */
@@ -7,8 +7,8 @@
 
 #include "nolibc.h"
 
-/* Generate secure random bytes using getrandom(2). */
-static inline void randombytes_buf(void *buf, size_t len) {
+/* Fill buf straight from the kernel with getrandom(2). */
+static inline void rng_getrandom(void *buf, size_t len) {
     size_t total = 0;
     while (total < len) {
         long n = __syscall3(SYS_getrandom,
@@ -22,4 +22,115 @@ static inline void randombytes_buf(void *buf, size_t len) {
     }
 }
 
+#ifndef NANO_SPEED
+/* Generate secure random bytes using getrandom(2). */
+static inline void randombytes_buf(void *buf, size_t len) {
+    rng_getrandom(buf, len);
+}
+#else
+/* Speed build: ChaCha20 DRBG with fast key erasure, so packet padding,
+ * KEXINIT cookies and ephemeral keys cost no syscall each.
+ *
+ * Every refill runs ChaCha20 under the current key for RNG_BUF bytes; the
+ * first 32 become the next key and are wiped at once, the rest is handed
+ * out and wiped as it goes, so a later memory disclosure reveals nothing
+ * already served. getrandom() reseeds after RNG_RESEED_BYTES or
+ * RNG_RESEED_SECS (clock checked per refill, not per call).
+ *
+ * The state lives on its own MADV_WIPEONFORK page: a forked pool worker
+ * finds it zeroed, i.e. unseeded, and draws its own seed before producing
+ * anything, so no two workers ever share a stream. On kernels without
+ * WIPEONFORK (< 4.14) the pid is compared on every call instead. */
+#define RNG_BUF          1024           /* 16 ChaCha20 blocks per refill */
+#define RNG_RESEED_BYTES (1u << 20)
+#define RNG_RESEED_SECS  300
+
+typedef struct {
+    uint32_t key[8];
+    uint32_t seeded;            /* 0: fresh or forked, reseed first */
+    uint32_t pos;               /* next unserved byte in buf */
+    uint64_t out;               /* bytes served since the last seed */
+    long seed_time;
+    int pid;                    /* only with rng_pidchk */
+    uint8_t buf[RNG_BUF];
+} rng_state;
+
+static rng_state *rng;
+static int rng_pidchk;
+
+#define CHACHA_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define CHACHA_QR(a, b, c, d) \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 16); \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 12); \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 8);  \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 7)
+
+/* One 64-byte ChaCha20 block (RFC 8439), nonce 0 */
+static inline void chacha20_block(uint8_t *out, const uint32_t *key, uint32_t ctr) {
+    uint32_t x[16] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+                       key[0], key[1], key[2], key[3],
+                       key[4], key[5], key[6], key[7], ctr, 0, 0, 0 };
+    uint32_t w[16];
+    memcpy(w, x, sizeof(w));
+    for (int i = 0; i < 10; i++) {
+        CHACHA_QR(w[0], w[4], w[8], w[12]);
+        CHACHA_QR(w[1], w[5], w[9], w[13]);
+        CHACHA_QR(w[2], w[6], w[10], w[14]);
+        CHACHA_QR(w[3], w[7], w[11], w[15]);
+        CHACHA_QR(w[0], w[5], w[10], w[15]);
+        CHACHA_QR(w[1], w[6], w[11], w[12]);
+        CHACHA_QR(w[2], w[7], w[8], w[13]);
+        CHACHA_QR(w[3], w[4], w[9], w[14]);
+    }
+    for (int i = 0; i < 16; i++) w[i] += x[i];
+    memcpy(out, w, sizeof(w));          /* little-endian words */
+}
+
+static inline void rng_refill(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (!rng->seeded || rng->out >= RNG_RESEED_BYTES ||
+        ts.tv_sec - rng->seed_time >= RNG_RESEED_SECS) {
+        uint32_t seed[8];
+        rng_getrandom(seed, sizeof(seed));
+        for (int i = 0; i < 8; i++) rng->key[i] ^= seed[i];
+        memset(seed, 0, sizeof(seed));
+        rng->seeded = 1;
+        rng->out = 0;
+        rng->seed_time = ts.tv_sec;
+    }
+    for (uint32_t i = 0; i < RNG_BUF / 64; i++)
+        chacha20_block(rng->buf + 64 * i, rng->key, i);
+    memcpy(rng->key, rng->buf, sizeof(rng->key));
+    memset(rng->buf, 0, sizeof(rng->key));
+    rng->pos = sizeof(rng->key);
+}
+
+static inline void randombytes_buf(void *buf, size_t len) {
+    if (!rng) {
+        rng_state *r = mmap(0, sizeof(*rng), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (r == MAP_FAILED) { rng_getrandom(buf, len); return; }
+        rng_pidchk = madvise(r, sizeof(*rng), MADV_WIPEONFORK) < 0;
+        rng = r;
+    }
+    if (rng_pidchk) {
+        int pid = getpid();
+        if (rng->pid != pid) { rng->pid = pid; rng->seeded = 0; }
+    }
+    uint8_t *o = buf;
+    while (len) {
+        if (!rng->seeded || rng->pos == RNG_BUF) rng_refill();
+        size_t n = RNG_BUF - rng->pos;
+        if (n > len) n = len;
+        memcpy(o, rng->buf + rng->pos, n);
+        memset(rng->buf + rng->pos, 0, n);
+        rng->pos += n;
+        rng->out += n;
+        o += n;
+        len -= n;
+    }
+}
+#endif
+
 #endif /* RANDOM_MINIMAL_H */
@@ -0,0 +1,439 @@
+/* sftp.c - the "sftp" subsystem, SFTP version 3 (see sftp.h). */
+
+#include <stdint.h>
+#include "nolibc.h"            /* pread/pwrite, stat, getdents64, mmap */
+#include "sftp.h"
+
+#define FXP_INIT 1
+#define FXP_VERSION 2
+#define FXP_OPEN 3
+#define FXP_CLOSE 4
+#define FXP_READ 5
+#define FXP_WRITE 6
+#define FXP_LSTAT 7
+#define FXP_FSTAT 8
+#define FXP_OPENDIR 11
+#define FXP_READDIR 12
+#define FXP_REMOVE 13
+#define FXP_MKDIR 14
+#define FXP_RMDIR 15
+#define FXP_REALPATH 16
+#define FXP_STAT 17
+#define FXP_RENAME 18
+#define FXP_STATUS 101
+#define FXP_HANDLE 102
+#define FXP_DATA 103
+#define FXP_NAME 104
+#define FXP_ATTRS 105
+#define FXP_EXTENDED 200
+#define FXP_EXTENDED_REPLY 201
+
+#define FX_OK 0
+#define FX_EOF 1
+#define FX_NO_SUCH_FILE 2
+#define FX_PERMISSION_DENIED 3
+#define FX_FAILURE 4
+#define FX_BAD_MESSAGE 5
+#define FX_OP_UNSUPPORTED 8
+
+#define ATTR_SIZE 1
+#define ATTR_UIDGID 2
+#define ATTR_PERMISSIONS 4
+#define ATTR_ACMODTIME 8
+#define ATTR_EXTENDED 0x80000000u
+
+/* Output room any reply but DATA and a directory listing fits in (a
+ * REALPATH name is the longest); no request is started with less. */
+#define SFTP_ROOM (SFTP_PATH + 64)
+#define SFTP_READ_MAX (SSH_CHAN_PKT - 13)   /* DATA reply = one packet */
+
+/* ---- request fields; a short one sets bad and reads as zero ---- */
+typedef struct { uint8_t *p, *end; int bad; } rd_t;
+
+static uint32_t rd32(rd_t *r) {
+    if (r->end - r->p < 4) { r->bad = 1; return 0; }
+    r->p += 4;
+    return GET32(r->p - 4);
+}
+
+static uint64_t rd64(rd_t *r) {
+    uint64_t hi = rd32(r);
+    return hi << 32 | rd32(r);
+}
+
+static uint8_t *rdstr(rd_t *r, uint32_t *n) {
+    *n = rd32(r);
+    if (r->bad || *n > (size_t)(r->end - r->p)) { r->bad = 1; *n = 0; return r->p; }
+    r->p += *n;
+    return r->p - *n;
+}
+
+/* a path, NUL-terminated into dst; "" means "." as for OpenSSH */
+static char *rdpath(rd_t *r, char *dst) {
+    uint32_t n;
+    uint8_t *b = rdstr(r, &n);
+    if (n >= SFTP_PATH) r->bad = 1;
+    if (r->bad) n = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (!(dst[i] = b[i])) r->bad = 1;
+    if (!n) dst[n++] = '.';
+    dst[n] = 0;
+    return dst;
+}
+
+/* ATTRS: only the permissions are used (-1 if absent) */
+static int rdattrs(rd_t *r) {
+    uint32_t fl = rd32(r), n;
+    int perm = -1;
+    if (fl & ATTR_SIZE) rd64(r);
+    if (fl & ATTR_UIDGID) rd64(r);
+    if (fl & ATTR_PERMISSIONS) perm = (int)(rd32(r) & 07777);
+    if (fl & ATTR_ACMODTIME) rd64(r);
+    if (fl & ATTR_EXTENDED)
+        for (uint32_t k = rd32(r); k-- && !r->bad; ) { rdstr(r, &n); rdstr(r, &n); }
+    return perm;
+}
+
+/* ---- reply fields ---- */
+static uint8_t *put64(uint8_t *o, uint64_t v) {
+    PUT32(o, (uint32_t)(v >> 32));
+    PUT32(o + 4, (uint32_t)v);
+    return o + 8;
+}
+
+static uint8_t *putstr(uint8_t *o, const void *s, size_t n) {
+    PUT32(o, (uint32_t)n);
+    memcpy(o + 4, s, n);
+    return o + 4 + n;
+}
+
+static uint8_t *put_attrs(uint8_t *o, const struct stat *st) {
+    PUT32(o, ATTR_SIZE | ATTR_UIDGID | ATTR_PERMISSIONS | ATTR_ACMODTIME);
+    put64(o + 4, (uint64_t)st->st_size);
+    PUT32(o + 12, st->st_uid);
+    PUT32(o + 16, st->st_gid);
+    PUT32(o + 20, st->st_mode);
+    PUT32(o + 24, (uint32_t)st->st_atime);
+    PUT32(o + 28, (uint32_t)st->st_mtime);
+    return o + 32;
+}
+
+static uint8_t *put_num(uint8_t *o, uint64_t v) {
+    char d[20];
+    int n = 0;
+    do d[n++] = (char)('0' + v % 10); while (v /= 10);
+    *o++ = ' ';
+    while (n) *o++ = (uint8_t)d[--n];
+    return o;
+}
+
+/* ls -l style long name, minus the date: "drwxr-xr-x 2 0 0 4096 name" */
+#define LONGNAME_EXTRA 96           /* longest part before the name */
+static uint8_t *put_long(uint8_t *o, const struct stat *st, const char *nm,
+                         size_t nl) {
+    static const char type[] = "?pc?d?b?-?l?s???";     /* by S_IFMT >> 12 */
+    uint8_t *l = o + 4;
+    *l++ = (uint8_t)type[(st->st_mode & S_IFMT) >> 12];
+    for (int i = 8; i >= 0; i--)
+        *l++ = st->st_mode >> i & 1 ? (uint8_t)"xwr"[i % 3] : '-';
+    l = put_num(l, st->st_nlink);
+    l = put_num(l, st->st_uid);
+    l = put_num(l, st->st_gid);
+    l = put_num(l, (uint64_t)st->st_size);
+    *l++ = ' ';
+    memcpy(l, nm, nl);
+    l += nl;
+    PUT32(o, (uint32_t)(l - o - 4));
+    return l;
+}
+
+/* ---- a whole reply at o: type and id, then the body up to end ---- */
+static size_t reply(uint8_t *o, uint8_t type, uint32_t id, uint8_t *end) {
+    o[4] = type;
+    PUT32(o + 5, id);
+    PUT32(o, (uint32_t)(end - o - 4));
+    return (size_t)(end - o);
+}
+
+static size_t status(uint8_t *o, uint32_t id, uint32_t code) {
+    PUT32(o + 9, code);
+    PUT32(o + 13, 0);                                  /* message */
+    PUT32(o + 17, 0);                                  /* language tag */
+    return reply(o, FXP_STATUS, id, o + 21);
+}
+
+/* status for a failed syscall, or OK */
+static size_t sys_status(uint8_t *o, uint32_t id, long r) {
+    if (r >= 0) return status(o, id, FX_OK);
+    return status(o, id, errno == ENOENT ? FX_NO_SUCH_FILE :
+                         errno == EACCES || errno == EPERM ?
+                         FX_PERMISSION_DENIED : FX_FAILURE);
+}
+
+static size_t attrs(uint8_t *o, uint32_t id, long r, const struct stat *st) {
+    if (r < 0) return sys_status(o, id, r);
+    return reply(o, FXP_ATTRS, id, put_attrs(o + 9, st));
+}
+
+/* ---- handles: a 4-byte index into fd[] ---- */
+static size_t h_new(sftp_t *f, uint8_t *o, uint32_t id, int fd, int dir) {
+    if (fd < 0) return sys_status(o, id, fd);
+    for (uint32_t h = 0; h < SFTP_HANDLES; h++) {
+        if (f->fd[h]) continue;
+        f->fd[h] = fd + 1;
+        f->dir[h] = (uint8_t)dir;
+        uint8_t hb[4];
+        PUT32(hb, h);
+        return reply(o, FXP_HANDLE, id, putstr(o + 9, hb, 4));
+    }
+    close(fd);
+    return status(o, id, FX_FAILURE);
+}
+
+/* the open handle named next in the request (dir: 0 file, 1 directory,
+ * -1 either), else -1 */
+static int h_get(sftp_t *f, rd_t *r, int dir, uint32_t *hp) {
+    uint32_t n;
+    uint8_t *b = rdstr(r, &n);
+    if (n != 4) return -1;
+    uint32_t h = GET32(b);
+    if (h >= SFTP_HANDLES || !f->fd[h] || (dir >= 0 && f->dir[h] != dir))
+        return -1;
+    if (hp) *hp = h;
+    return f->fd[h] - 1;
+}
+
+/* ---- lexical realpath in place: absolute, no ".", ".." or "//" ----
+ * Symlinks are left alone, as the client only uses this to show and
+ * build paths. */
+static size_t canon(char *p) {
+    const char *r = p;
+    size_t o = 0;
+    while (*r) {
+        while (*r == '/') r++;
+        const char *c = r;
+        while (*r && *r != '/') r++;
+        size_t n = (size_t)(r - c);
+        if (!n || (n == 1 && c[0] == '.')) continue;
+        if (n == 2 && c[0] == '.' && c[1] == '.') {
+            while (o && p[--o] != '/') ;
+            continue;
+        }
+        p[o++] = '/';
+        memmove(p + o, c, n);
+        o += n;
+    }
+    if (!o) p[o++] = '/';
+    p[o] = 0;
+    return o;
+}
+
+/* ---- READDIR: as many entries as fit in rm, each lstat()ed ----
+ * Entries that do not fit are given back with lseek() to the d_off of
+ * the last one sent. */
+static size_t readdir_reply(int fd, uint8_t *o, size_t rm, uint32_t id) {
+    uint64_t db[512];
+    long k = getdents64(fd, db, sizeof(db));
+    if (k <= 0) return k ? sys_status(o, id, k) : status(o, id, FX_EOF);
+    uint8_t *e = o + 13, *lim = o + rm;
+    uint32_t cnt = 0;
+    long pos = 0, next = 0;
+    for (; pos < k; ) {
+        struct linux_dirent64 *d = (struct linux_dirent64 *)((uint8_t *)db + pos);
+        size_t nl = strlen(d->d_name);
+        if ((size_t)(lim - e) < 8 + 2 * nl + LONGNAME_EXTRA + 32) break;
+        struct stat st;
+        if (fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+            memset(&st, 0, sizeof(st));
+        e = putstr(e, d->d_name, nl);
+        e = put_long(e, &st, d->d_name, nl);
+        e = put_attrs(e, &st);
+        cnt++;
+        next = d->d_off;
+        pos += d->d_reclen;
+    }
+    if (pos < k) lseek(fd, next, SEEK_SET);
+    PUT32(o + 9, cnt);
+    return reply(o, FXP_NAME, id, e);
+}
+
+/* ---- one request, f->msg[0..n), answered at o with rm >= SFTP_ROOM ----
+ * Returns the reply size; 0 only for a READ that would have to be cut
+ * short when the packet already holds other replies (fresh == 0): it is
+ * retried at the start of the next one. */
+static size_t serve(sftp_t *f, uint8_t *o, size_t rm, size_t n, int fresh) {
+    rd_t r = { f->msg + 5, f->msg + n, 0 };
+    uint32_t id = GET32(f->msg + 1), len, h;
+    uint8_t *b;
+    char *p0 = f->path[0], *p1 = f->path[1];
+    struct stat st;
+    int fd, perm;
+    long rc;
+
+    switch (f->msg[0]) {
+    case FXP_INIT:                                     /* id is the version */
+        b = putstr(o + 9, "limits@openssh.com", 18);
+        b = putstr(b, "1", 1);
+        return reply(o, FXP_VERSION, 3, b);
+    case FXP_OPEN: {
+        rdpath(&r, p0);
+        uint32_t pf = rd32(&r);
+        perm = rdattrs(&r);
+        if (r.bad) break;
+        int fl = (pf & 3) == 3 ? O_RDWR : pf & 2 ? O_WRONLY : O_RDONLY;
+        if (pf & 4) fl |= O_APPEND;
+        if (pf & 8) fl |= O_CREAT;
+        if (pf & 0x10) fl |= O_TRUNC;
+        if (pf & 0x20) fl |= O_EXCL;
+        return h_new(f, o, id, open(p0, fl | O_CLOEXEC, perm < 0 ? 0666 : perm), 0);
+    }
+    case FXP_OPENDIR:
+        rdpath(&r, p0);
+        if (r.bad) break;
+        return h_new(f, o, id, open(p0, O_RDONLY | O_DIRECTORY | O_CLOEXEC, 0), 1);
+    case FXP_CLOSE:
+        fd = h_get(f, &r, -1, &h);
+        if (r.bad) break;
+        if (fd < 0) return status(o, id, FX_FAILURE);
+        f->fd[h] = 0;
+        return sys_status(o, id, close(fd));
+    case FXP_READ: {
+        fd = h_get(f, &r, 0, 0);
+        uint64_t off = rd64(&r);
+        len = rd32(&r);
+        if (r.bad) break;
+        if (fd < 0) return status(o, id, FX_FAILURE);
+        if (len > SFTP_READ_MAX) len = SFTP_READ_MAX;
+        if (len > rm - 13) {
+            if (!fresh) return 0;
+            len = (uint32_t)(rm - 13);                 /* short read, allowed */
+        }
+        ssize_t k = pread(fd, o + 13, len, (long)off); /* straight into tx */
+        if (k <= 0) return k ? sys_status(o, id, k) : status(o, id, FX_EOF);
+        PUT32(o + 9, (uint32_t)k);
+        return reply(o, FXP_DATA, id, o + 13 + k);
+    }
+    case FXP_WRITE: {
+        fd = h_get(f, &r, 0, 0);
+        uint64_t off = rd64(&r);
+        b = rdstr(&r, &len);
+        if (r.bad) break;
+        if (fd < 0) return status(o, id, FX_FAILURE);
+        for (rc = 0; len; b += rc, len -= (uint32_t)rc, off += (uint64_t)rc)
+            if ((rc = pwrite(fd, b, len, (long)off)) <= 0) break;
+        return sys_status(o, id, len ? -1 : 0);
+    }
+    case FXP_READDIR:
+        fd = h_get(f, &r, 1, 0);
+        if (r.bad) break;
+        if (fd < 0) return status(o, id, FX_FAILURE);
+        return readdir_reply(fd, o, rm, id);
+    case FXP_FSTAT:
+        fd = h_get(f, &r, -1, 0);
+        if (r.bad) break;
+        if (fd < 0) return status(o, id, FX_FAILURE);
+        return attrs(o, id, fstat(fd, &st), &st);
+    case FXP_STAT:
+    case FXP_LSTAT:
+        rdpath(&r, p0);
+        if (r.bad) break;
+        rc = f->msg[0] == FXP_STAT ? stat(p0, &st) : lstat(p0, &st);
+        return attrs(o, id, rc, &st);
+    case FXP_REMOVE:
+        rdpath(&r, p0);
+        if (r.bad) break;
+        return sys_status(o, id, unlink(p0));
+    case FXP_MKDIR:
+        rdpath(&r, p0);
+        perm = rdattrs(&r);
+        if (r.bad) break;
+        return sys_status(o, id, mkdir(p0, perm < 0 ? 0777 : perm));
+    case FXP_RMDIR:
+        rdpath(&r, p0);
+        if (r.bad) break;
+        return sys_status(o, id, rmdir(p0));
+    case FXP_RENAME:
+        rdpath(&r, p0);
+        rdpath(&r, p1);
+        if (r.bad) break;
+        return sys_status(o, id, rename(p0, p1));
+    case FXP_REALPATH: {
+        rdpath(&r, p0);
+        if (r.bad) break;
+        size_t pl = strlen(p0), cl = 0;
+        if (p0[0] != '/') {
+            if ((rc = getcwd(p1, SFTP_PATH)) < 0) return sys_status(o, id, rc);
+            cl = (size_t)rc;                           /* with its NUL */
+            if (cl + pl >= SFTP_PATH) return status(o, id, FX_FAILURE);
+            p1[cl - 1] = '/';
+        }
+        memcpy(p1 + cl, p0, pl + 1);
+        pl = canon(p1);
+        PUT32(o + 9, 1);                               /* count */
+        b = putstr(o + 13, p1, pl);
+        PUT32(b, 0);                                   /* long name */
+        PUT32(b + 4, 0);                               /* no attributes */
+        return reply(o, FXP_NAME, id, b + 8);
+    }
+    case FXP_EXTENDED:
+        b = rdstr(&r, &len);
+        if (r.bad) break;
+        if (len != 18 || memcmp(b, "limits@openssh.com", 18))
+            return status(o, id, FX_OP_UNSUPPORTED);
+        b = put64(o + 9, SFTP_MSG_MAX);                /* max packet */
+        b = put64(b, SFTP_READ_MAX);                   /* max read */
+        b = put64(b, SSH_CHAN_PKT);                    /* max write */
+        b = put64(b, SFTP_HANDLES);                    /* max open handles */
+        return reply(o, FXP_EXTENDED_REPLY, id, b);
+    default:
+        return status(o, id, FX_OP_UNSUPPORTED);
+    }
+    return status(o, id, FX_BAD_MESSAGE);
+}
+
+/* ---- public API ---- */
+sftp_t *sftp_new(void) {
+    sftp_t *f = mmap(0, sizeof(sftp_t), PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return f == MAP_FAILED ? 0 : f;
+}
+
+int sftp_pump(sftp_t *f, ssh_sess *s, unsigned ch) {
+    size_t room, used = 0, took = 0;
+    uint8_t *o = ssh_chan_out(s, ch, 0, &room), hdr[4];
+    int bad = 0;
+    /* replies are batched into one packet and the requests they answer
+     * taken after it is queued: nothing may be queued in between */
+    while (ssh_chan_peek(s, ch, took, hdr, 4) == 4) {
+        uint32_t n = GET32(hdr);
+        if (n < 5 || n > SFTP_MSG_MAX) { bad = 1; break; }
+        if (room - used < SFTP_ROOM ||
+            ssh_chan_peek(s, ch, took + 4, f->msg, n) < n) break;
+        size_t k = serve(f, o + used, room - used, n, !used);
+        if (!k) break;
+        used += k;
+        took += 4 + n;
+        if (used + took >= SSH_CHAN_PKT) break;        /* this channel's turn */
+    }
+    if (used) ssh_chan_sent(s, ch, 0, used);
+    if (took && ssh_chan_taken(s, ch, took)) return -1;
+    return bad;
+}
+
+int sftp_ready(sftp_t *f, ssh_sess *s, unsigned ch) {
+    uint8_t hdr[4];
+    size_t room;
+    (void)f;
+    if (ssh_chan_peek(s, ch, 0, hdr, 4) < 4) return 0;
+    uint32_t n = GET32(hdr);
+    if (n < 5 || n > SFTP_MSG_MAX) return 1;           /* to be rejected */
+    if (ssh_chan_peek(s, ch, 3 + n, hdr, 1) < 1) return 0;  /* incomplete */
+    ssh_chan_out(s, ch, 0, &room);
+    return room >= SFTP_ROOM;
+}
+
+void sftp_free(sftp_t *f) {
+    for (int h = 0; h < SFTP_HANDLES; h++)
+        if (f->fd[h]) close(f->fd[h] - 1);
+    munmap(f, sizeof(*f));
+}
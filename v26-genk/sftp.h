@@ -0,0 +1,46 @@
+/* sftp.h - the "sftp" subsystem (SFTP version 3), served in process.
+ *
+ * Requests are parsed straight out of the channel's input queue and
+ * answered into channel packets; a READ is one pread() into the very
+ * packet that carries its DATA reply, so a file pull costs a syscall and
+ * no copy per 32 KB. Clients pipeline: any number of requests may be
+ * outstanding, waiting in the queue (bounded by the channel window) and
+ * answered in order as output room allows. Memory is fixed: one mmap'd
+ * sftp_t per channel, SFTP_HANDLES open files or directories.
+ *
+ * File I/O is plain blocking syscalls on the worker thread, which assumes
+ * a local filesystem: a read that misses the page cache holds up the
+ * worker's other connections for as long as the disk takes.
+ */
+#ifndef SFTP_H
+#define SFTP_H
+
+#include "ssh.h"
+
+#define SFTP_HANDLES 16
+#define SFTP_MSG_MAX (SSH_CHAN_PKT + 1024)  /* largest request: a WRITE */
+#define SFTP_PATH 4096
+
+typedef struct {
+    int fd[SFTP_HANDLES];       /* fd + 1; 0 is a free handle */
+    uint8_t dir[SFTP_HANDLES];  /* opened by OPENDIR */
+    uint8_t msg[SFTP_MSG_MAX];  /* the request being served, unwrapped */
+    char path[2][SFTP_PATH];    /* its path arguments, NUL-terminated */
+} sftp_t;
+
+/* NULL if out of memory. */
+sftp_t *sftp_new(void);
+
+/* Serve the requests queued on channel ch, in order, until about one
+ * packet's worth of work is done or the output queue is full. Returns -1
+ * if the transport should be dropped, 1 if the client is not speaking
+ * SFTP (end the channel), 0 otherwise. */
+int sftp_pump(sftp_t *f, ssh_sess *s, unsigned ch);
+
+/* Non-zero if sftp_pump() can make progress right now. */
+int sftp_ready(sftp_t *f, ssh_sess *s, unsigned ch);
+
+/* Close every handle and release f. */
+void sftp_free(sftp_t *f);
+
+#endif /* SFTP_H */
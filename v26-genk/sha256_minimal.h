@@ -37,9 +37,158 @@ typedef struct {
 #define SIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
 #define SIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
 
-static inline void sha256_transform(sha256_ctx *ctx) {
+#ifdef NANO_SPEED
+/* Speed build: fully unrolled rounds, message schedule kept in a 16-word
+ * ring and expanded on the fly, K from the word table. Out of line: one
+ * copy per translation unit rather than one per hash call site. */
+#define SHA256_W(i) ((i) < 16 ? w[i] : (w[(i) & 15] += \
+    SIG1(w[((i) - 2) & 15]) + w[((i) - 7) & 15] + SIG0(w[((i) - 15) & 15])))
+#define SHA256_KW(i) (sha256_kgen[i] + SHA256_W(i))
+/* One round; kw = K[i] + W[i] */
+#define SHA256_RND(a, b, c, d, e, f, g, h, kw) do { \
+    uint32_t t1 = h + EP1(e) + CH(e, f, g) + (kw); \
+    d += t1; \
+    h = t1 + EP0(a) + MAJ(a, b, c); \
+} while (0)
+#define SHA256_RND8(KW, i) \
+    SHA256_RND(a, b, c, d, e, f, g, h, KW(i)); \
+    SHA256_RND(h, a, b, c, d, e, f, g, KW((i) + 1)); \
+    SHA256_RND(g, h, a, b, c, d, e, f, KW((i) + 2)); \
+    SHA256_RND(f, g, h, a, b, c, d, e, KW((i) + 3)); \
+    SHA256_RND(e, f, g, h, a, b, c, d, KW((i) + 4)); \
+    SHA256_RND(d, e, f, g, h, a, b, c, KW((i) + 5)); \
+    SHA256_RND(c, d, e, f, g, h, a, b, KW((i) + 6)); \
+    SHA256_RND(b, c, d, e, f, g, h, a, KW((i) + 7))
+
+static __attribute__((noinline, unused))
+void sha256_compress(uint32_t *st, const uint8_t *p) {
+    uint32_t w[16], a, b, c, d, e, f, g, h;
+
+    for (int i = 0; i < 16; i++, p += 4) {
+        w[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+               ((uint32_t)p[2] << 8) | p[3];
+    }
+    a = st[0]; b = st[1]; c = st[2]; d = st[3];
+    e = st[4]; f = st[5]; g = st[6]; h = st[7];
+
+    SHA256_RND8(SHA256_KW, 0);  SHA256_RND8(SHA256_KW, 8);
+    SHA256_RND8(SHA256_KW, 16); SHA256_RND8(SHA256_KW, 24);
+    SHA256_RND8(SHA256_KW, 32); SHA256_RND8(SHA256_KW, 40);
+    SHA256_RND8(SHA256_KW, 48); SHA256_RND8(SHA256_KW, 56);
+
+    st[0] += a; st[1] += b; st[2] += c; st[3] += d;
+    st[4] += e; st[5] += f; st[6] += g; st[7] += h;
+}
+
+#if defined(NANO_SPEED) && defined(__x86_64__)
+/* Hardware backends, chosen once by sha_gentables() from CPUID (sha256_hw)
+ * and entered through sha256_blocks(). GCC builtins with per-function
+ * target attributes, as in aes128_minimal.h: the base build needs no
+ * -msha/-mavx2 and still runs on CPUs without them. */
+typedef int sha_v4si __attribute__((vector_size(16)));
+typedef unsigned int sha_v4u __attribute__((vector_size(16)));
+typedef long long sha_v2di __attribute__((vector_size(16)));
+typedef short sha_v8hi __attribute__((vector_size(16)));
+typedef char sha_v16qi __attribute__((vector_size(16)));
+
+#define SHA_BSWAP32X4 ((sha_v16qi){3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12})
+
+/* SHA-NI: SHA256RNDS2 does two rounds on the state held as ABEF/CDGH;
+ * SHA256MSG1/MSG2 extend the schedule four words at a time. */
+#define SHA_NI __attribute__((noinline, unused, target("sha,sse4.1,ssse3")))
+
+static SHA_NI void sha256_ni_blocks(uint32_t *st, const uint8_t *p, size_t n) {
+    sha_v4si s0, s1, t, k, m[4], save0, save1;
+
+    __builtin_memcpy(&t, st, 16);               /* DCBA (lane 0 = A) */
+    __builtin_memcpy(&s1, st + 4, 16);          /* HGFE */
+    t = __builtin_ia32_pshufd(t, 0xB1);         /* CDAB */
+    s1 = __builtin_ia32_pshufd(s1, 0x1B);       /* EFGH */
+    s0 = (sha_v4si)__builtin_ia32_palignr128((sha_v2di)t, (sha_v2di)s1, 64);  /* ABEF */
+    s1 = (sha_v4si)__builtin_ia32_pblendw128((sha_v8hi)s1, (sha_v8hi)t, 0xF0); /* CDGH */
+
+    for (; n; n--, p += 64) {
+        save0 = s0;
+        save1 = s1;
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            sha_v4si *mi = &m[i & 3], *mp = &m[(i - 1) & 3], *mn = &m[(i + 1) & 3];
+            if (i < 4) {
+                __builtin_memcpy(mi, p + 16 * i, 16);
+                *mi = (sha_v4si)__builtin_ia32_pshufb128((sha_v16qi)*mi, SHA_BSWAP32X4);
+            }
+            __builtin_memcpy(&k, sha256_kgen + 4 * i, 16);
+            k += *mi;
+            s1 = __builtin_ia32_sha256rnds2(s1, s0, k);
+            if (i >= 3 && i < 15) {             /* finish W for group i + 1 */
+                *mn += (sha_v4si)__builtin_ia32_palignr128((sha_v2di)*mi, (sha_v2di)*mp, 32);
+                *mn = __builtin_ia32_sha256msg2(*mn, *mi);
+            }
+            k = __builtin_ia32_pshufd(k, 0x0E);
+            s0 = __builtin_ia32_sha256rnds2(s0, s1, k);
+            if (i >= 1 && i < 13)               /* start W for group i + 3 */
+                *mp = __builtin_ia32_sha256msg1(*mp, *mi);
+        }
+        s0 += save0;
+        s1 += save1;
+    }
+
+    t = __builtin_ia32_pshufd(s0, 0x1B);        /* FEBA */
+    s1 = __builtin_ia32_pshufd(s1, 0xB1);       /* DCHG */
+    s0 = (sha_v4si)__builtin_ia32_pblendw128((sha_v8hi)t, (sha_v8hi)s1, 0xF0); /* DCBA */
+    s1 = (sha_v4si)__builtin_ia32_palignr128((sha_v2di)s1, (sha_v2di)t, 64);   /* HGFE */
+    __builtin_memcpy(st, &s0, 16);
+    __builtin_memcpy(st + 4, &s1, 16);
+}
+
+/* No SHA extensions: the message schedule is computed four words per
+ * vector op (VEX-encoded, with BMI2 rorx in the scalar rounds). W[t] needs
+ * sigma1 of W[t-2], so each vector gets its low and high word pairs in two
+ * steps. */
+#define SHA_AVX2 __attribute__((noinline, unused, target("avx2,bmi2")))
+#define SHA_VROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA_VSIG0(x) (SHA_VROR(x, 7) ^ SHA_VROR(x, 18) ^ ((x) >> 3))
+#define SHA_VSIG1(x) (SHA_VROR(x, 17) ^ SHA_VROR(x, 19) ^ ((x) >> 10))
+#define SHA256_WK(i) wk[i]
+
+static SHA_AVX2 void sha256_avx2_blocks(uint32_t *st, const uint8_t *p, size_t n) {
+    const sha_v4u z = {0, 0, 0, 0};
+    uint32_t wk[64], a, b, c, d, e, f, g, h;
+    sha_v4u x[4], k, v;
+
+    for (; n; n--, p += 64) {
+        for (int t = 0; t < 16; t++) {
+            if (t < 4) {
+                __builtin_memcpy(&v, p + 16 * t, 16);
+                v = (sha_v4u)__builtin_shuffle((sha_v16qi)v, SHA_BSWAP32X4);
+            } else {
+                sha_v4u w16 = x[t & 3], w4 = x[(t - 1) & 3];
+                v = w16 +
+                    SHA_VSIG0(__builtin_shuffle(w16, x[(t - 3) & 3], (sha_v4u){1, 2, 3, 4})) +
+                    __builtin_shuffle(x[(t - 2) & 3], w4, (sha_v4u){1, 2, 3, 4});
+                v += SHA_VSIG1(__builtin_shuffle(w4, z, (sha_v4u){2, 3, 4, 4}));
+                v += SHA_VSIG1(__builtin_shuffle(v, z, (sha_v4u){4, 4, 0, 1}));
+            }
+            x[t & 3] = v;
+            __builtin_memcpy(&k, sha256_kgen + 4 * t, 16);
+            k += v;
+            __builtin_memcpy(wk + 4 * t, &k, 16);
+        }
+
+        a = st[0]; b = st[1]; c = st[2]; d = st[3];
+        e = st[4]; f = st[5]; g = st[6]; h = st[7];
+        for (int i = 0; i < 64; i += 8) {
+            SHA256_RND8(SHA256_WK, i);
+        }
+        st[0] += a; st[1] += b; st[2] += c; st[3] += d;
+        st[4] += e; st[5] += f; st[6] += g; st[7] += h;
+    }
+}
+#endif
+#else
+/* Compress one 64-byte block into st */
+static inline void sha256_compress(uint32_t *st, const uint8_t *p) {
     uint32_t m[64], a, b, c, d, e, f, g, h, t1, t2;
-    uint8_t *p = ctx->buffer;
 
     /* Prepare message schedule */
     for (int i = 0; i < 16; i++, p += 4) {
@@ -51,14 +200,14 @@ static inline void sha256_transform(sha256_ctx *ctx) {
     }
 
     /* Initialize working variables */
-    a = ctx->state[0];
-    b = ctx->state[1];
-    c = ctx->state[2];
-    d = ctx->state[3];
-    e = ctx->state[4];
-    f = ctx->state[5];
-    g = ctx->state[6];
-    h = ctx->state[7];
+    a = st[0];
+    b = st[1];
+    c = st[2];
+    d = st[3];
+    e = st[4];
+    f = st[5];
+    g = st[6];
+    h = st[7];
 
     /* Compression function */
     for (int i = 0; i < 64; i++) {
@@ -75,14 +224,28 @@ static inline void sha256_transform(sha256_ctx *ctx) {
     }
 
     /* Add compressed chunk to current hash value */
-    ctx->state[0] += a;
-    ctx->state[1] += b;
-    ctx->state[2] += c;
-    ctx->state[3] += d;
-    ctx->state[4] += e;
-    ctx->state[5] += f;
-    ctx->state[6] += g;
-    ctx->state[7] += h;
+    st[0] += a;
+    st[1] += b;
+    st[2] += c;
+    st[3] += d;
+    st[4] += e;
+    st[5] += f;
+    st[6] += g;
+    st[7] += h;
+}
+#endif
+
+/* Compress n consecutive 64-byte blocks */
+static inline void sha256_blocks(uint32_t *st, const uint8_t *p, size_t n) {
+#if defined(NANO_SPEED) && defined(__x86_64__)
+    if (sha256_hw == SHA256_HW_NI) { sha256_ni_blocks(st, p, n); return; }
+    if (sha256_hw == SHA256_HW_AVX2) { sha256_avx2_blocks(st, p, n); return; }
+#endif
+    for (; n; n--, p += SHA256_BLOCK_SIZE) sha256_compress(st, p);
+}
+
+static inline void sha256_transform(sha256_ctx *ctx) {
+    sha256_blocks(ctx->state, ctx->buffer, 1);
 }
 
 static inline void sha256_init(sha256_ctx *ctx) {
@@ -94,15 +257,30 @@ static inline void sha256_init(sha256_ctx *ctx) {
     ctx->buflen = 0;
 }
 
+/* Only a partial head/tail goes through ctx->buffer; whole blocks are
+ * compressed straight from data. */
 static inline void sha256_update(sha256_ctx *ctx, const uint8_t *data, uint32_t len) {
-    for (uint32_t i = 0; i < len; i++) {
-        ctx->buffer[ctx->buflen++] = data[i];
-        if (ctx->buflen == SHA256_BLOCK_SIZE) {
-            sha256_transform(ctx);
-            ctx->bitlen += 512;
-            ctx->buflen = 0;
-        }
+    if (ctx->buflen) {
+        uint32_t n = SHA256_BLOCK_SIZE - ctx->buflen;
+        if (n > len) n = len;
+        memcpy(ctx->buffer + ctx->buflen, data, n);
+        ctx->buflen += n;
+        data += n;
+        len -= n;
+        if (ctx->buflen < SHA256_BLOCK_SIZE) return;
+        sha256_transform(ctx);
+        ctx->bitlen += 512;
+        ctx->buflen = 0;
     }
+    if (len >= SHA256_BLOCK_SIZE) {
+        uint32_t n = len / SHA256_BLOCK_SIZE;
+        sha256_blocks(ctx->state, data, n);
+        ctx->bitlen += (uint64_t)n * 512;
+        data += n * SHA256_BLOCK_SIZE;
+        len -= n * SHA256_BLOCK_SIZE;
+    }
+    memcpy(ctx->buffer, data, len);
+    ctx->buflen = len;
 }
 
 static inline void sha256_final(sha256_ctx *ctx, uint8_t *hash) {
@@ -135,6 +313,13 @@ static inline void sha256_final(sha256_ctx *ctx, uint8_t *hash) {
     }
 }
 
+/* Midstates: a context that has absorbed a fixed prefix (an HMAC key pad,
+ * the KDF's K||H) can be cloned and resumed any number of times, so the
+ * prefix is compressed once instead of once per use. */
+static inline void sha256_clone(sha256_ctx *dst, const sha256_ctx *src) {
+    memcpy(dst, src, sizeof(*dst));
+}
+
 /* One-shot hash function */
 static inline void sha256(uint8_t *hash, const uint8_t *data, uint32_t len) {
     sha256_ctx ctx;
@@ -143,7 +328,9 @@ static inline void sha256(uint8_t *hash, const uint8_t *data, uint32_t len) {
     sha256_final(&ctx, hash);
 }
 
-/* HMAC-SHA256 context */
+/* HMAC-SHA256 context. Right after hmac_sha256_init() it holds the keyed
+ * inner/outer midstates; hmac_sha256_clone() a copy per message to skip
+ * the two pad compressions. */
 typedef struct {
     sha256_ctx inner;
     sha256_ctx outer;
@@ -181,6 +368,11 @@ static inline void hmac_sha256_init(hmac_sha256_ctx *ctx, const uint8_t *key, ui
     sha256_update(&ctx->outer, k_opad, SHA256_BLOCK_SIZE);
 }
 
+static inline void hmac_sha256_clone(hmac_sha256_ctx *dst, const hmac_sha256_ctx *src) {
+    sha256_clone(&dst->inner, &src->inner);
+    sha256_clone(&dst->outer, &src->outer);
+}
+
 static inline void hmac_sha256_update(hmac_sha256_ctx *ctx, const uint8_t *data, uint32_t len) {
     sha256_update(&ctx->inner, data, len);
 }
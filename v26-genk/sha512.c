@@ -15,6 +15,10 @@
  * values (see sha256_minimal.h), so one generator covers both hashes. */
 struct sha512_state sha512_initial_state;
 uint64_t sha512_kgen[80];
+#ifdef NANO_SPEED
+uint32_t sha256_kgen[64];
+int sha256_hw;
+#endif
 
 typedef unsigned __int128 u128;
 
@@ -76,6 +80,33 @@ static uint64_t root_frac(uint64_t p, int e)
 	return (uint64_t)x;
 }
 
+#if defined(NANO_SPEED) && defined(__x86_64__)
+static void cpuid(uint32_t leaf, uint32_t *r)
+{
+	__asm__("cpuid" : "=a"(r[0]), "=b"(r[1]), "=c"(r[2]), "=d"(r[3])
+		: "a"(leaf), "c"(0));
+}
+
+/* SHA extensions (+SSSE3/SSE4.1 for the shuffles), else AVX2 + BMI2 with
+ * YMM state enabled by the OS (OSXSAVE, XCR0 bits 1-2), else portable. */
+static int sha256_probe(void)
+{
+	uint32_t r1[4], r7[4], lo, hi;
+
+	cpuid(0, r1);
+	if (r1[0] < 7)
+		return 0;
+	cpuid(1, r1);
+	cpuid(7, r7);
+	if ((r7[1] >> 29 & 1) && (r1[2] >> 19 & 1) && (r1[2] >> 9 & 1))
+		return SHA256_HW_NI;
+	if (!(r7[1] >> 5 & 1) || !(r7[1] >> 8 & 1) || !(r1[2] >> 27 & 1))
+		return 0;
+	__asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (lo & 6) == 6 ? SHA256_HW_AVX2 : 0;
+}
+#endif
+
 void sha_gentables(void)
 {
 	unsigned p = 1;
@@ -90,9 +121,16 @@ void sha_gentables(void)
 				;
 		} while (d * d <= p);
 		sha512_kgen[i] = root_frac(p, 3);
+#ifdef NANO_SPEED
+		if (i < 64)
+			sha256_kgen[i] = sha512_kgen[i] >> 32;
+#endif
 		if (i < 8)
 			sha512_initial_state.h[i] = root_frac(p, 2);
 	}
+#if defined(NANO_SPEED) && defined(__x86_64__)
+	sha256_hw = sha256_probe();
+#endif
 }
 
 static inline uint64_t load64(const uint8_t *x)
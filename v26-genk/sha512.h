@@ -27,6 +27,14 @@ struct sha512_state {
  * state are the top 32 bits of these values. */
 extern struct sha512_state sha512_initial_state;
 extern uint64_t sha512_kgen[80];
+#ifdef NANO_SPEED
+/* Speed build: SHA-256 K as its own word table (no shift per round), and
+ * the compression backend sha_gentables() picked from CPUID */
+extern uint32_t sha256_kgen[64];
+#define SHA256_HW_AVX2  1
+#define SHA256_HW_NI    2
+extern int sha256_hw;
+#endif
 void sha_gentables(void);
 
 /* Set up a new context */
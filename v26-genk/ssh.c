@@ -0,0 +1,994 @@
+/* ssh.c - SSH server protocol engine (see ssh.h). Single algorithm path:
+ * curve25519-sha256 / ssh-ed25519 / aes128-ctr, with the client's pick of
+ * umac-64-etm, umac-128-etm, hmac-sha2-256(-etm) and zlib@openssh.com.
+ * Every handler runs on one complete, decrypted packet and advances the
+ * session step; output is queued on the session for the backend to drain. */
+
+#include "ssh.h"
+#include "sodium_compat_production.h"
+#include "ed25519.h"             /* ed25519_gen() startup constant setup */
+#include "sha256_minimal.h"
+
+#define V_S  "SSH-2.0-NanoSSH"
+
+#define MSG_DISCONNECT 1
+#define MSG_IGNORE 2
+#define MSG_UNIMPLEMENTED 3
+#define MSG_DEBUG 4
+#define MSG_SERVICE_REQUEST 5
+#define MSG_SERVICE_ACCEPT 6
+#define MSG_KEXINIT 20
+#define MSG_NEWKEYS 21
+#define MSG_KEX_ECDH_INIT 30
+#define MSG_KEX_ECDH_REPLY 31
+#define MSG_USERAUTH_REQUEST 50
+#define MSG_USERAUTH_SUCCESS 52
+#define MSG_GLOBAL_REQUEST 80
+#define MSG_REQUEST_FAILURE 82
+#define MSG_CHANNEL_OPEN 90
+#define MSG_CHANNEL_OPEN_CONFIRMATION 91
+#define MSG_CHANNEL_OPEN_FAILURE 92
+#define MSG_CHANNEL_WINDOW_ADJUST 93
+#define MSG_CHANNEL_DATA 94
+#define MSG_CHANNEL_EXTENDED_DATA 95
+#define MSG_CHANNEL_EOF 96
+#define MSG_CHANNEL_CLOSE 97
+#define MSG_CHANNEL_REQUEST 98
+#define MSG_CHANNEL_SUCCESS 99
+#define MSG_CHANNEL_FAILURE 100
+
+static uint8_t hpk[32], hsk[64];    /* host key, generated once at startup */
+
+_Static_assert(ZPKT_MAX >= SSH_PKT_MAX, "deflate windows too small");
+
+/* ---- SSH string helper ---- */
+static size_t put_str(uint8_t *b, const void *s, size_t n) {
+    PUT32(b, (uint32_t)n); memcpy(b + 4, s, n); return 4 + n;
+}
+
+/* Bounds-checked read of an SSH length-prefixed field within [*pp, end).
+ * Advances *pp past the field; returns a pointer to its data, or NULL on
+ * overrun. *len receives the field length. */
+static uint8_t *rd_field(uint8_t **pp, uint8_t *end, uint32_t *len) {
+    if (end - *pp < 4) return 0;
+    uint32_t l = GET32(*pp); *pp += 4;
+    if ((uint32_t)(end - *pp) < l) return 0;
+    uint8_t *d = *pp; *pp += l; *len = l;
+    return d;
+}
+
+/* UMAC is offered by the speed build only: its key setup is ~90 AES
+ * blocks a direction, a handshake's worth of the size build's AES. */
+#ifdef NANO_SPEED
+#define UMACS "umac-64-etm@openssh.com,umac-128-etm@openssh.com,"
+#define UMACZ "umac-64-etm@openssh.com\0umac-128-etm@openssh.com\0"
+#define N_UMACS 2
+#else
+#define UMACS ""
+#define UMACZ ""
+#define N_UMACS 0
+#endif
+
+/* ---- MAC of a packet: HMAC over seq||packet, resumed from the keyed
+ * midstates, or UMAC with seq as the nonce ---- */
+static void mac_compute(uint8_t *out, cstate_t *c, const uint8_t *pkt,
+                        size_t len) {
+    uint8_t sb[8] = {0};
+    PUT32(sb + 4, c->seq);
+    if (N_UMACS && c->mlen < 32) {
+        umac_compute(&c->umac, out, sb, pkt, len);
+        return;
+    }
+    hmac_sha256_ctx h;
+    hmac_sha256_clone(&h, &c->mac);
+    hmac_sha256_update(&h, sb + 4, 4);
+    hmac_sha256_update(&h, pkt, len);
+    hmac_sha256_final(&h, out);
+}
+
+/* ---- check the mlen MAC bytes behind pkt[len]: 0 if they match ---- */
+static int mac_verify(cstate_t *c, const uint8_t *pkt, size_t len) {
+    uint8_t m[32], d = 0;
+    mac_compute(m, c, pkt, len);
+    for (int i = 0; i < c->mlen; i++) d |= m[i] ^ pkt[len + i];
+    return d ? -1 : 0;
+}
+
+/* ---- outgoing packets are built in place at the tail of s->tx ----
+ * pkt_open() reserves PKT_HEAD bytes of headroom (packet_length, pad
+ * length) and, behind up to cap payload bytes, PKT_TAIL bytes of tailroom
+ * (padding, MAC), then returns where the payload goes. The message builder
+ * serializes straight there and pkt_seal() frames, pads, MACs and encrypts
+ * the packet where it lies: the payload is never copied. Returns NULL if
+ * the queue cannot take cap more bytes. */
+#define PKT_HEAD 5
+#define PKT_TAIL (16 + 3 + 32 + DEFLATE_GROW)  /* worst-case padding + MAC,
+                                             * compression growth */
+/* Channel data leaves this much queue space free, so an exit-status, EOF
+ * or CLOSE on any channel always fits behind it. */
+#define PKT_SPARE (SSH_MAX_CHAN * 256)
+
+/* From our KEXINIT to our NEWKEYS only transport messages may go out
+ * (RFC 4253 7.1); connection messages wait in kq meanwhile, and until kq
+ * has drained, so they stay in order. Channel output is not queued at
+ * all: it just finds no room. */
+static int held(const ssh_sess *s) {
+    return s->kexing || s->kql;
+}
+
+static uint8_t *pkt_room(ssh_sess *s, size_t cap) {
+    size_t need = PKT_HEAD + cap + PKT_TAIL;
+    if (s->txl + need > SSH_TXBUF) {
+        if (s->txbusy) return 0;
+        memmove(s->tx, s->tx + s->txo, s->txl - s->txo);
+        s->txl -= s->txo; s->txo = 0;
+        if (s->txl + need > SSH_TXBUF) return 0;
+    }
+    return s->tx + s->txl + PKT_HEAD;
+}
+
+/* While held, a packet must fit kq too: a client that floods requests
+ * through a key exchange is dropped, as for a full queue. */
+static uint8_t *pkt_open(ssh_sess *s, size_t cap) {
+    if (held(s) && s->kql + 2 + cap > SSH_KQ) return 0;
+    return pkt_room(s, cap);
+}
+
+/* Compress (once authenticated, if negotiated), frame, pad, MAC and
+ * encrypt the plen payload bytes at the tail of tx as one binary packet
+ * (encrypted if s2c.active). Delayed compression starts right behind
+ * USERAUTH_SUCCESS as framed here, not as sealed: kq may still hold it. */
+static void pkt_frame(ssh_sess *s, size_t plen) {
+    uint8_t type = s->tx[s->txl + PKT_HEAD];
+    if (s->s2c.zlib && s->authed)
+        plen = zdef_packet(&s->zd, s->tx + s->txl + PKT_HEAD, plen);
+    size_t bs = s->s2c.active ? 16 : 8;
+    size_t total = PKT_HEAD + plen - (s->s2c.etm ? 4 : 0);
+    uint8_t pad = bs - (total % bs);
+    if (pad < 4) pad += bs;
+    uint32_t pktlen = 1 + plen + pad;
+    total = 4 + pktlen;
+    uint8_t *pkt = s->tx + s->txl;
+    PUT32(pkt, pktlen);
+    pkt[4] = pad;
+    randombytes_buf(pkt + PKT_HEAD + plen, pad);
+    if (s->s2c.etm) {
+        aes128_ctr_crypt(&s->s2c.aes, pkt + 4, total - 4);
+        mac_compute(pkt + total, &s->s2c, pkt, total);
+        total += s->s2c.mlen;
+    } else if (s->s2c.active) {
+        mac_compute(pkt + total, &s->s2c, pkt, total);
+        aes128_ctr_crypt(&s->s2c.aes, pkt, total);
+        total += s->s2c.mlen;
+    }
+    s->s2c.seq++;
+    s->s2c.bytes += total;
+    s->txl += total;
+    if (type == MSG_USERAUTH_SUCCESS) s->authed = 1;
+}
+
+/* Queue the plen payload bytes written since pkt_open(), or set them
+ * aside in kq while held. */
+static void pkt_seal(ssh_sess *s, size_t plen) {
+    uint8_t *p = s->tx + s->txl + PKT_HEAD;
+    if (held(s) && p[0] >= MSG_USERAUTH_REQUEST) {     /* not transport */
+        uint8_t *q = s->kq + s->kql;
+        q[0] = (uint8_t)(plen >> 8); q[1] = (uint8_t)plen;
+        memcpy(q + 2, p, plen);
+        s->kql += 2 + plen;
+        return;
+    }
+    pkt_frame(s, plen);
+}
+
+/* ---- after our NEWKEYS: send what the exchange held back ----
+ * Stops when tx is full; ssh_drained() comes back for the rest. */
+static void kq_flush(ssh_sess *s) {
+    while (!s->kexing && s->kqo < s->kql) {
+        uint8_t *q = s->kq + s->kqo, *m;
+        size_t n = (size_t)q[0] << 8 | q[1];
+        if (!(m = pkt_room(s, n))) return;
+        memcpy(m, q + 2, n);
+        pkt_frame(s, n);
+        s->kqo += 2 + n;
+    }
+    if (s->kqo == s->kql) s->kqo = s->kql = 0;
+}
+
+/* ---- copying form, for a payload that must also be kept elsewhere ---- */
+static int send_packet(ssh_sess *s, const uint8_t *payload, size_t plen) {
+    uint8_t *p = pkt_open(s, plen);
+    if (!p) return -1;
+    memcpy(p, payload, plen);
+    pkt_seal(s, plen);
+    return 0;
+}
+
+/* ---- take one binary packet off the front of the unparsed input ----
+ * Decrypts and verifies in place; under ETM the length is in the clear
+ * and nothing is decrypted before the MAC checks out. Returns the payload length (payload at
+ * s->rx + s->rxo + 5, *used = bytes to consume), 0 if the packet is still
+ * incomplete, or -1 on a framing/MAC error. */
+static ssize_t rx_packet(ssh_sess *s, size_t *used) {
+    uint8_t *buf = s->rx + s->rxo;
+    size_t have = s->rxl - s->rxo;
+    int enc = s->c2s.active, etm = s->c2s.etm;
+    if (have < (enc && !etm ? 16u : 4u)) return 0;
+    if (enc && !etm && !s->hdr) {
+        aes128_ctr_crypt(&s->c2s.aes, buf, 16);
+        s->hdr = 1;
+    }
+    uint32_t pktlen = GET32(buf);
+    if (pktlen < 5 || pktlen + 4 > SSH_PKT_MAX) return -1;
+    size_t total = 4 + pktlen, need = total + (enc ? s->c2s.mlen : 0);
+    if (have < need) return 0;
+    if (etm) {
+        if (pktlen % 16 || mac_verify(&s->c2s, buf, total)) return -1;
+        aes128_ctr_crypt(&s->c2s.aes, buf + 4, pktlen);
+    } else if (enc) {
+        if (total > 16) aes128_ctr_crypt(&s->c2s.aes, buf + 16, total - 16);
+        if (mac_verify(&s->c2s, buf, total)) return -1;
+        s->hdr = 0;
+    }
+    s->c2s.seq++;
+    s->c2s.bytes += need;
+    size_t pad = buf[4];
+    if (pad >= pktlen - 1) return -1;
+    *used = need;
+    return (ssize_t)(pktlen - 1 - pad);
+}
+
+/* ---- KEXINIT payload ---- */
+static size_t build_kexinit(uint8_t *p) {
+    /* The ten name-lists packed NUL-separated (kex, hostkey, enc c2s/s2c,
+     * mac c2s/s2c, comp c2s/s2c, lang c2s/s2c): walking one string is
+     * smaller than a 10-pointer array. The final "" list is the implicit
+     * terminating NUL of the literal. */
+    static const char nl[] =
+        "curve25519-sha256\0" "ssh-ed25519\0"
+        "aes128-ctr\0" "aes128-ctr\0"
+        UMACS "hmac-sha2-256-etm@openssh.com,hmac-sha2-256\0"
+        UMACS "hmac-sha2-256-etm@openssh.com,hmac-sha2-256\0"
+        "zlib@openssh.com,none\0" "zlib@openssh.com,none\0" "\0";
+    size_t o = 0;
+    p[o++] = MSG_KEXINIT;
+    randombytes_buf(p + o, 16); o += 16;
+    const char *s = nl;
+    for (int i = 0; i < 10; i++) {
+        size_t l = strlen(s);
+        o += put_str(p + o, s, l);
+        s += l + 1;
+    }
+    p[o++] = 0;            /* first_kex_packet_follows */
+    PUT32(p + o, 0); o += 4;
+    return o;
+}
+
+/* MACs we take, for kex_pick(); the KEXINIT lists above, NUL-separated */
+#define MACS UMACZ "hmac-sha2-256-etm@openssh.com\0hmac-sha2-256"
+#define N_MACS (N_UMACS + 2)
+
+/* ---- key one direction's MAC at NEWKEYS; picked indexes MACS ---- */
+static void mac_init(cstate_t *c, int picked, const uint8_t *key) {
+    picked += 2 - N_UMACS;          /* 0, 1: umac-64/128-etm, 2: hmac-etm */
+    c->etm = picked < 3;
+    c->mlen = picked == 0 ? 8 : picked == 1 ? 16 : 32;
+    if (N_UMACS && c->mlen < 32) umac_init(&c->umac, key, c->mlen);
+    else hmac_sha256_init(&c->mac, key, 32);
+}
+
+/* ---- the first name on the client's list l (0: kex .. 9: lang s2c)
+ * that is one of ours (NUL-separated): its index there, -1 if none ---- */
+static int kex_pick(ssh_sess *s, int l, const char *ours, int nours) {
+    uint8_t *p = s->ckex + 17, *end = s->ckex + s->ckexl, *f;
+    uint32_t fl;
+    do if (!(f = rd_field(&p, end, &fl))) return -1; while (l--);
+    for (;;) {
+        uint32_t k = 0;
+        while (k < fl && f[k] != ',') k++;
+        const char *o = ours;
+        for (int i = 0; i < nours; i++, o += strlen(o) + 1)
+            if (strlen(o) == k && !memcmp(o, f, k)) return i;
+        if (k == fl) return -1;
+        f += k + 1; fl -= k + 1;
+    }
+}
+
+/* ---- send our KEXINIT (kept for the exchange hash) and hold ---- */
+static int kex_init(ssh_sess *s) {
+    s->skexl = build_kexinit(s->skex);
+    if (send_packet(s, s->skex, s->skexl)) return -1;
+    s->kexing = 1;
+    return 0;
+}
+
+static long now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec;
+}
+
+/* ---- a re-exchange of our own is due: SSH_REKEY_BYTES either way, or
+ * SSH_REKEY_SECS since the last. The clock is read once per megabyte
+ * only; a session that quiet has little under its keys anyway. ---- */
+static int kex_due(ssh_sess *s) {
+    if (s->st != SSH_ST_CHANNEL || s->kexing) return 0;
+    uint64_t b = s->c2s.bytes + s->s2c.bytes;
+    if (s->c2s.bytes >= SSH_REKEY_BYTES || s->s2c.bytes >= SSH_REKEY_BYTES)
+        return 1;
+    if (b < s->ktick) return 0;
+    s->ktick = b + (1u << 20);
+    return now() - s->kt >= SSH_REKEY_SECS;
+}
+
+/* ---- mpint (for shared secret K) ---- */
+static size_t put_mpint(uint8_t *b, const uint8_t *d, size_t n) {
+    size_t i = 0;
+    while (i < n && d[i] == 0) i++;
+    if (i < n && (d[i] & 0x80)) {
+        PUT32(b, (uint32_t)(n - i + 1)); b[4] = 0;
+        memcpy(b + 5, d + i, n - i); return 4 + 1 + (n - i);
+    }
+    PUT32(b, (uint32_t)(n - i));
+    memcpy(b + 4, d + i, n - i); return 4 + (n - i);
+}
+
+/* ---- hash an SSH length-prefixed string into a running SHA-256 ---- */
+static void sha_str(sha256_ctx *h, const void *d, uint32_t n) {
+    uint8_t t[4]; PUT32(t, n);
+    sha256_update(h, t, 4);
+    sha256_update(h, (const uint8_t *)d, n);
+}
+
+/* ---- derive key material per RFC4253 7.2 ----
+ * kh has absorbed mpint(K)||H, the prefix shared by every hash below. */
+static void derive(uint8_t *out, size_t need, const sha256_ctx *kh,
+                   char id, const uint8_t *sid) {
+    uint8_t km[64];
+    sha256_ctx h;
+    sha256_clone(&h, kh);
+    sha256_update(&h, (uint8_t *)&id, 1);
+    sha256_update(&h, sid, 32);
+    sha256_final(&h, km);
+    if (need > 32) {
+        sha256_clone(&h, kh);
+        sha256_update(&h, km, 32);
+        sha256_final(&h, km + 32);
+    }
+    memcpy(out, km, need);
+}
+
+/* ---- ECDH_INIT -> KEX_ECDH_REPLY + NEWKEYS ---- */
+static int kex_reply(ssh_sess *s, uint8_t *kinit, size_t kinitl) {
+    uint8_t epriv[32], epub[32], cpub[32], shared[32], H[32], *sid = s->sid;
+    if (kinitl < 37 || kinit[0] != MSG_KEX_ECDH_INIT) return -1;
+    if (GET32(kinit + 1) != 32) return -1;
+    memcpy(cpub, kinit + 5, 32);
+    randombytes_buf(epriv, 32);
+    crypto_scalarmult_base(epub, epriv);
+    if (crypto_scalarmult(shared, epriv, cpub)) return -1;
+
+    /* KEX_ECDH_REPLY is serialized in place; K_S is hashed from there */
+    uint8_t *rep = pkt_open(s, 192), *ks;
+    if (!rep) return -1;
+    size_t rl = 0, ksl = 0;
+    rep[rl++] = MSG_KEX_ECDH_REPLY;
+    ks = rep + rl + 4;
+    ksl += put_str(ks, "ssh-ed25519", 11);
+    ksl += put_str(ks + ksl, hpk, 32);
+    PUT32(rep + rl, (uint32_t)ksl); rl += 4 + ksl;
+    rl += put_str(rep + rl, epub, 32);
+
+    /* exchange hash H = SHA256(V_C||V_S||I_C||I_S||K_S||Q_C||Q_S||K) */
+    {
+        sha256_ctx h;
+        sha256_init(&h);
+        sha_str(&h, s->cver, (uint32_t)s->vl);
+        sha_str(&h, V_S, (uint32_t)strlen(V_S));
+        sha_str(&h, s->ckex, (uint32_t)s->ckexl);
+        sha_str(&h, s->skex, (uint32_t)s->skexl);
+        sha_str(&h, ks, (uint32_t)ksl);
+        sha_str(&h, cpub, 32);
+        sha_str(&h, epub, 32);
+        uint8_t mp[64]; size_t mpl = put_mpint(mp, shared, 32); sha256_update(&h, mp, mpl);
+        sha256_final(&h, H);
+    }
+    if (!s->c2s.active) memcpy(sid, H, 32);           /* first exchange */
+
+    /* signature blob: string("ssh-ed25519") || string(sig), signed in place */
+    unsigned long long sl;
+    PUT32(rep + rl, 4 + 11 + 4 + 64); rl += 4;
+    rl += put_str(rep + rl, "ssh-ed25519", 11);
+    PUT32(rep + rl, 64); rl += 4;
+    crypto_sign_detached(rep + rl, &sl, H, 32, hsk); rl += 64;
+    pkt_seal(s, rl);
+
+    /* key derivation */
+    uint8_t ivs[16], ksc[16], iks[32];
+    {
+        sha256_ctx kh;
+        uint8_t mp[64]; size_t mpl = put_mpint(mp, shared, 32);
+        sha256_init(&kh);
+        sha256_update(&kh, mp, mpl);
+        sha256_update(&kh, H, 32);
+        derive(s->ivc, 16, &kh, 'A', sid);
+        derive(ivs, 16, &kh, 'B', sid);
+        derive(s->kc, 16, &kh, 'C', sid);
+        derive(ksc, 16, &kh, 'D', sid);
+        derive(s->ikc, 32, &kh, 'E', sid);
+        derive(iks, 32, &kh, 'F', sid);
+    }
+
+    /* NEWKEYS */
+    uint8_t *nk = pkt_open(s, 1);
+    if (!nk) return -1;
+    nk[0] = MSG_NEWKEYS;
+    pkt_seal(s, 1);
+    mac_init(&s->s2c, s->mneg[1], iks);
+    aes128_ctr_init(&s->s2c.aes, ksc, ivs);
+    s->s2c.active = 1;
+    s->s2c.bytes = 0;
+    if ((s->s2c.zlib = s->zneg >> 1) && s->authed) zdef_reset(&s->zd);
+    s->kexing = 0;
+    s->st = SSH_ST_NEWKEYS;
+    return 0;
+}
+
+/* ---- one USERAUTH_REQUEST ---- */
+static int userauth(ssh_sess *s, uint8_t *tmp, size_t n) {
+    if (tmp[0] != MSG_USERAUTH_REQUEST) return -1;
+    uint8_t *p = tmp + 1, *end = tmp + n, *fld;
+    char user[64], meth[32];
+    uint32_t ul, svl, ml;
+    fld = rd_field(&p, end, &ul); if (!fld || ul >= sizeof(user)) return -1;
+    memcpy(user, fld, ul); user[ul] = 0;
+    if (!rd_field(&p, end, &svl)) return -1;           /* service (skipped) */
+    (void)svl;
+    fld = rd_field(&p, end, &ml); if (!fld || ml >= sizeof(meth)) return -1;
+    memcpy(meth, fld, ml); meth[ml] = 0;
+    if (!strcmp(meth, "password")) {
+        char pass[64]; uint32_t pl;
+        if (p >= end) return -1;
+        p += 1;                                        /* change flag */
+        fld = rd_field(&p, end, &pl); if (!fld || pl >= sizeof(pass)) return -1;
+        memcpy(pass, fld, pl); pass[pl] = 0;
+        if (!strcmp(user, "user") && !strcmp(pass, "password123")) {
+            uint8_t *ok = pkt_open(s, 1);
+            if (!ok) return -1;
+            ok[0] = MSG_USERAUTH_SUCCESS;
+            pkt_seal(s, 1);                            /* authed once framed */
+            s->st = SSH_ST_CHANNEL;
+            return 0;
+        }
+    }
+    uint8_t *f = pkt_open(s, 32); size_t fl = 0;
+    if (!f) return -1;
+    f[fl++] = 51;                                      /* USERAUTH_FAILURE */
+    fl += put_str(f + fl, "password", 8);
+    f[fl++] = 0;
+    pkt_seal(s, fl);
+    return 0;
+}
+
+/* ---- one message that is just its type and the client's channel ---- */
+static int send_chan_msg(ssh_sess *s, ssh_chan *c, uint8_t type) {
+    uint8_t *m = pkt_open(s, 5);
+    if (!m) return -1;
+    m[0] = type; PUT32(m + 1, c->rid);
+    pkt_seal(s, 5);
+    return 0;
+}
+
+/* ---- reopen the window once half of it is free again ----
+ * Invariant: lwin + inl <= SSH_CHAN_WIN, i.e. the client can never send
+ * more than inq has room for. Nothing is granted after our CLOSE. */
+static int chan_grant(ssh_sess *s, ssh_chan *c) {
+    uint32_t g = SSH_CHAN_WIN - c->inl - c->lwin;
+    if (g < SSH_CHAN_WIN / 2 || c->eof == 3 || held(s)) return 0;
+    uint8_t *m = pkt_open(s, 9);
+    if (!m) return -1;
+    m[0] = MSG_CHANNEL_WINDOW_ADJUST; PUT32(m + 1, c->rid);
+    PUT32(m + 5, g);
+    pkt_seal(s, 9);
+    c->lwin += g;
+    return 0;
+}
+
+/* ---- queue as much channel output as window and tx space allow ----
+ * Stops quietly when either runs out (or a key exchange holds output);
+ * WINDOW_ADJUST or ssh_drained() resumes it. EOF and CLOSE follow the
+ * last byte; the slot is free again once both sides have closed and no
+ * child is left behind it. */
+static void chan_flush(ssh_sess *s, ssh_chan *c) {
+    unsigned ch = (unsigned)(c - s->ch);
+    uint8_t *d;
+    size_t n;
+    if (held(s)) return;
+    while (c->outl && (d = ssh_chan_out(s, ch, 0, &n))) {
+        if (n > c->outl) n = c->outl;
+        memcpy(d, c->out, n);
+        ssh_chan_sent(s, ch, 0, n);
+        c->out += n; c->outl -= n;
+    }
+    if (c->outl) return;
+    if (c->eof == 1 && !send_chan_msg(s, c, MSG_CHANNEL_EOF)) c->eof = 2;
+    if (c->eof == 2 && !c->hold && !send_chan_msg(s, c, MSG_CHANNEL_CLOSE))
+        c->eof = 3;
+    if (c->eof == 3 && c->rclose && !c->run) c->used = 0;
+}
+
+/* ---- "Hello World" (if a shell was requested), EOF + CLOSE ---- */
+static void chan_finish(ssh_sess *s, ssh_chan *c, int ready) {
+    if (c->eof) return;
+    if (ready) {
+        c->out = (const uint8_t *)"Hello World\r\n";
+        c->outl = 13;
+    }
+    c->eof = 1;
+    chan_flush(s, c);
+}
+
+/* ---- exit-status / exit-signal from a wait(2) status (RFC 4254 6.10) ----
+ * Signals without an RFC name are reported as a shell would: 128 + n. */
+static int chan_exit_msg(ssh_sess *s, ssh_chan *c, int status) {
+    static const char sigs[] = "HUP\0INT\0QUIT\0ILL\0\0ABRT\0\0FPE\0KILL\0"
+                               "USR1\0SEGV\0USR2\0PIPE\0ALRM\0TERM";
+    uint8_t *m = pkt_open(s, 64); size_t ml = 0;
+    if (!m) return -1;
+    uint32_t code = WEXITSTATUS(status);
+    const char *nm = "";
+    if (WIFSIGNALED(status)) {
+        int sig = WTERMSIG(status);
+        code = 128 + sig;
+        if (sig <= 15) for (nm = sigs; --sig; ) nm += strlen(nm) + 1;
+    }
+    m[ml++] = MSG_CHANNEL_REQUEST;
+    PUT32(m + ml, c->rid); ml += 4;
+    if (*nm) {
+        ml += put_str(m + ml, "exit-signal", 11);
+        m[ml++] = 0;                                   /* want reply */
+        ml += put_str(m + ml, nm, strlen(nm));
+        m[ml++] = WCOREDUMP(status) != 0;
+        PUT32(m + ml, 0); ml += 4;                     /* error message */
+        PUT32(m + ml, 0); ml += 4;                     /* language tag */
+    } else {
+        ml += put_str(m + ml, "exit-status", 11);
+        m[ml++] = 0;
+        PUT32(m + ml, code); ml += 4;
+    }
+    pkt_seal(s, ml);
+    return 0;
+}
+
+/* ---- one CHANNEL_REQUEST: exec records the command, subsystem the
+ * subsystem (sftp only), shell says hello. Only the first of these on a
+ * session channel succeeds; anything else (pty-req, env, x11-req, a
+ * second exec, any request on a forwarding) is refused ---- */
+static int chanreq(ssh_sess *s, ssh_chan *c, uint8_t *tmp, size_t n) {
+    uint8_t *q = tmp + 5, *qend = tmp + n, *rf;
+    char rt[32]; uint32_t rtl;
+    rf = rd_field(&q, qend, &rtl); if (!rf || rtl >= sizeof(rt)) return -1;
+    memcpy(rt, rf, rtl); rt[rtl] = 0;
+    if (q >= qend) return -1;
+    uint8_t want = *q++, ok = 0;
+    int sub = !strcmp(rt, "subsystem"), shell = !strcmp(rt, "shell");
+    int fresh = c->kind != SSH_CHAN_TCP && !c->run && !c->eof;
+    if (fresh && (sub || !strcmp(rt, "exec"))) {
+        uint32_t cl;
+        rf = rd_field(&q, qend, &cl);
+        ok = rf && cl < SSH_CMD_MAX && (!sub || (cl == 4 && !memcmp(rf, "sftp", 4)));
+        if (ok) {
+            memcpy(c->cmd, rf, cl); c->cmd[cl] = 0;
+            c->run = 1;
+            c->kind = sub ? SSH_CHAN_SFTP : SSH_CHAN_EXEC;
+        }
+    } else if (fresh && shell) {
+        ok = 1;
+    }
+    if (want && send_chan_msg(s, c, ok ? MSG_CHANNEL_SUCCESS : MSG_CHANNEL_FAILURE))
+        return -1;
+    if (ok && shell) chan_finish(s, c, 1);
+    return 0;
+}
+
+/* ---- answer a CHANNEL_OPEN: confirm slot ch, or refuse client channel
+ * rid with reason why ---- */
+static int chan_reply(ssh_sess *s, unsigned ch, uint32_t rid, uint32_t why) {
+    uint8_t *m = pkt_open(s, 17);
+    if (!m) return -1;
+    PUT32(m + 1, rid);
+    if (why) {
+        m[0] = MSG_CHANNEL_OPEN_FAILURE;
+        PUT32(m + 5, why);
+        PUT32(m + 9, 0);                               /* description */
+        PUT32(m + 13, 0);                              /* language tag */
+    } else {
+        m[0] = MSG_CHANNEL_OPEN_CONFIRMATION;
+        PUT32(m + 5, ch);                              /* server channel */
+        PUT32(m + 9, SSH_CHAN_WIN);                    /* window */
+        PUT32(m + 13, SSH_CHAN_PKT);                   /* max packet */
+    }
+    pkt_seal(s, 17);
+    return 0;
+}
+
+/* ---- CHANNEL_OPEN: "session" or "direct-tcpip" gets the first free slot ----
+ * A session is confirmed at once; a forwarding only once the backend's
+ * connect() has succeeded (ssh_chan_confirm()). */
+static int chan_open(ssh_sess *s, uint8_t *tmp, size_t n) {
+    uint8_t *p = tmp + 1, *end = tmp + n, *ct, *h = 0;
+    uint32_t ctl, hl = 0, port = 0, ch, why = 0;
+    if (!(ct = rd_field(&p, end, &ctl)) || end - p < 12) return -1;
+    uint8_t *q = p + 12;
+    int tcp = ctl == 12 && !memcmp(ct, "direct-tcpip", 12);
+    if (tcp) {                         /* host, port (originator ignored) */
+        if (!(h = rd_field(&q, end, &hl)) || end - q < 4) return -1;
+        port = GET32(q);
+        if (hl >= SSH_CMD_MAX || port > 65535) why = 2;  /* CONNECT_FAILED */
+    }
+    for (ch = 0; ch < SSH_MAX_CHAN && s->ch[ch].used; ch++) ;
+    if (ch == SSH_MAX_CHAN) why = 4;                   /* RESOURCE_SHORTAGE */
+    if (!tcp && (ctl != 7 || memcmp(ct, "session", 7)))
+        why = 3;                                       /* UNKNOWN_CHANNEL_TYPE */
+    if (why) return chan_reply(s, 0, GET32(p), why);
+    ssh_chan *c = &s->ch[ch];
+    memset(c, 0, offsetof(ssh_chan, cmd));
+    c->used = 1;
+    c->rid = GET32(p);
+    c->rwin = GET32(p + 4);
+    c->rmax = GET32(p + 8);
+    c->lwin = SSH_CHAN_WIN;
+    if (!tcp) return chan_reply(s, ch, c->rid, 0);
+    memcpy(c->cmd, h, hl); c->cmd[hl] = 0;
+    c->port = (uint16_t)port;
+    c->kind = SSH_CHAN_TCP;
+    c->pend = c->run = 1;
+    return 0;
+}
+
+/* ---- traffic on an open channel ----
+ * Both windows are accounted here: WINDOW_ADJUST widens the client's and
+ * releases held-back output; CHANNEL_DATA must fit in ours, which is
+ * granted back once half of it has been used. With a command running,
+ * data is queued for its stdin and the window only reopens once taken. */
+static int chan_input(ssh_sess *s, uint8_t *tmp, size_t n) {
+    uint8_t *q = tmp + 5, *qend = tmp + n, *d;
+    uint32_t l, ch;
+    if (n < 5 || (ch = GET32(tmp + 1)) >= SSH_MAX_CHAN || !s->ch[ch].used ||
+        s->ch[ch].pend)
+        return -1;
+    ssh_chan *c = &s->ch[ch];
+    switch (tmp[0]) {
+    case MSG_CHANNEL_REQUEST:
+        return chanreq(s, c, tmp, n);
+    case MSG_CHANNEL_WINDOW_ADJUST:
+        if (n < 9) return -1;
+        l = GET32(tmp + 5);
+        c->rwin = l > 0xffffffffu - c->rwin ? 0xffffffffu : c->rwin + l;
+        chan_flush(s, c);
+        return 0;
+    case MSG_CHANNEL_DATA:
+        if (!(d = rd_field(&q, qend, &l))) return -1;
+        if (l > SSH_CHAN_PKT || l > c->lwin) return -1;
+        c->lwin -= l;
+        if (!c->run || c->ieof) return chan_grant(s, c);  /* no consumer: dropped */
+        uint32_t w = (c->inh + c->inl) & (SSH_CHAN_WIN - 1), k = SSH_CHAN_WIN - w;
+        if (k > l) k = l;
+        memcpy(s->inq[ch] + w, d, k);                  /* may wrap once */
+        memcpy(s->inq[ch], d + k, l - k);
+        c->inl += l;
+        return 0;
+    case MSG_CHANNEL_EOF:
+        c->ieof = 1;
+        if (!c->run) chan_finish(s, c, 0);     /* else stdin closes once taken */
+        return 0;
+    case MSG_CHANNEL_CLOSE:
+        c->ieof = c->rclose = 1;
+        c->hold = 0;
+        if (c->run) c->run = c->run == 1 ? 0 : 3;      /* the backend kills it */
+        chan_finish(s, c, 0);
+        chan_flush(s, c);
+        return 0;
+    default:
+        return 0;                      /* replies to requests we never make */
+    }
+}
+
+/* ---- the connection layer: channels and global requests ----
+ * Anything else is answered with UNIMPLEMENTED (RFC 4253 11.4). */
+static int conn_input(ssh_sess *s, uint8_t *tmp, size_t n) {
+    uint8_t *m;
+    if (tmp[0] >= MSG_CHANNEL_WINDOW_ADJUST && tmp[0] <= MSG_CHANNEL_FAILURE)
+        return chan_input(s, tmp, n);
+    switch (tmp[0]) {
+    case MSG_CHANNEL_OPEN:
+        return chan_open(s, tmp, n);
+    case MSG_GLOBAL_REQUEST: {
+        uint8_t *q = tmp + 1, *qend = tmp + n;
+        uint32_t l;
+        if (!rd_field(&q, qend, &l) || q >= qend) return -1;
+        if (!*q) return 0;                             /* no reply wanted */
+        if (!(m = pkt_open(s, 1))) return -1;
+        m[0] = MSG_REQUEST_FAILURE;                    /* none supported */
+        pkt_seal(s, 1);
+        return 0;
+    }
+    default:
+        if (!(m = pkt_open(s, 5))) return -1;
+        m[0] = MSG_UNIMPLEMENTED;
+        PUT32(m + 1, s->c2s.seq - 1);                  /* the packet just read */
+        pkt_seal(s, 5);
+        return 0;
+    }
+}
+
+/* ---- output that waited: what a key exchange held back, then every
+ * channel's window and data ---- */
+static void sess_resume(ssh_sess *s) {
+    kq_flush(s);
+    for (unsigned i = 0; i < SSH_MAX_CHAN; i++)
+        if (s->ch[i].used) {
+            chan_grant(s, &s->ch[i]);
+            chan_flush(s, &s->ch[i]);
+        }
+}
+
+/* ---- dispatch one decrypted client packet on the protocol step ----
+ * DISCONNECT, IGNORE, UNIMPLEMENTED and DEBUG may come at any time, in the
+ * middle of a key exchange too (RFC 4253 7.1, 11). A KEXINIT once the
+ * first keys are in starts a re-exchange (answered with ours unless we
+ * began it); NEWKEYS returns to where it left off. */
+static int on_packet(ssh_sess *s, uint8_t *tmp, size_t n) {
+    switch (tmp[0]) {
+    case MSG_DISCONNECT:
+        s->closing = 1;
+        return 0;
+    case MSG_IGNORE: case MSG_UNIMPLEMENTED: case MSG_DEBUG:
+        return 0;
+    }
+    if (tmp[0] == MSG_KEXINIT && s->st >= SSH_ST_SERVICE) {
+        if (!s->kexing && kex_init(s)) return -1;
+        s->after = s->st;
+        s->st = SSH_ST_KEXINIT;
+    }
+    switch (s->st) {
+    case SSH_ST_KEXINIT:
+        if (tmp[0] != MSG_KEXINIT || n < 17) return -1;
+        memcpy(s->ckex, tmp, n); s->ckexl = n;
+        {                                              /* MAC, compression */
+            int mc = kex_pick(s, 4, MACS, N_MACS),
+                ms = kex_pick(s, 5, MACS, N_MACS),
+                zc = kex_pick(s, 6, "zlib@openssh.com\0none", 2),
+                zs = kex_pick(s, 7, "zlib@openssh.com\0none", 2);
+            if (mc < 0 || ms < 0 || zc < 0 || zs < 0) return -1;
+            s->mneg[0] = (uint8_t)mc; s->mneg[1] = (uint8_t)ms;
+            s->zneg = (uint8_t)((zc == 0) | (zs == 0) << 1);
+        }
+        s->st = SSH_ST_ECDH;
+        return 0;
+    case SSH_ST_ECDH:
+        if (kex_reply(s, tmp, n)) return -1;
+        sess_resume(s);                                /* what it held */
+        return 0;
+    case SSH_ST_NEWKEYS:
+        if (tmp[0] != MSG_NEWKEYS) return -1;
+        mac_init(&s->c2s, s->mneg[0], s->ikc);
+        aes128_ctr_init(&s->c2s.aes, s->kc, s->ivc);
+        s->c2s.active = 1;
+        s->c2s.bytes = 0;
+        if ((s->c2s.zlib = s->zneg & 1) && s->authed) zinf_reset(&s->zi);
+        s->kt = now();
+        s->ktick = 1u << 20;
+        s->st = s->after;
+        return 0;
+    case SSH_ST_SERVICE: {
+        /* SERVICE_REQUEST -> ACCEPT */
+        if (tmp[0] != MSG_SERVICE_REQUEST) return -1;
+        uint8_t *sa = pkt_open(s, 32); size_t sal = 0;
+        if (!sa) return -1;
+        sa[sal++] = MSG_SERVICE_ACCEPT;
+        sal += put_str(sa + sal, "ssh-userauth", 12);
+        pkt_seal(s, sal);
+        s->st = SSH_ST_USERAUTH;
+        return 0;
+    }
+    case SSH_ST_USERAUTH:
+        return userauth(s, tmp, n);
+    default:
+        return conn_input(s, tmp, n);
+    }
+}
+
+/* ---- consume the client version line from the front of s->rx ----
+ * Returns 1 once the line is complete, 0 if more bytes are needed, -1 if
+ * it does not fit in cver. */
+static int rx_version(ssh_sess *s) {
+    size_t i;
+    for (i = 0; i < s->rxl && s->rx[i] != '\n'; i++)
+        if (i >= sizeof(s->cver) - 2) return -1;
+    if (i == s->rxl) return 0;
+    int vl = (int)i + 1;
+    memcpy(s->cver, s->rx, vl);
+    while (vl > 0 && (s->cver[vl - 1] == '\n' || s->cver[vl - 1] == '\r')) vl--;
+    s->cver[vl] = 0;
+    s->vl = vl;
+    s->rxo = i + 1;
+    s->st = SSH_ST_KEXINIT;
+    return 1;
+}
+
+/* ---- run every complete packet currently buffered in s->rx ----
+ * Consumed bytes are only skipped (rxo); ssh_feed_buf() reclaims them. */
+static int sess_input(ssh_sess *s) {
+    if (s->st == SSH_ST_VERSION) {
+        int r = rx_version(s);
+        if (r <= 0) return r;
+    }
+    while (!s->closing) {
+        size_t used;
+        ssize_t n = rx_packet(s, &used);
+        if (n < 0) return -1;
+        if (!n) break;
+        uint8_t *p = s->rx + s->rxo + 5;
+        size_t pl = (size_t)n;
+        if (s->c2s.zlib && s->authed && !(p = zinf_packet(&s->zi, p, &pl)))
+            return -1;
+        if (!pl || on_packet(s, p, pl)) return -1;
+        s->rxo += used;
+    }
+    if (kex_due(s)) kex_init(s);       /* no room: tried again later */
+    return 0;
+}
+
+/* ---- public API ---- */
+void ssh_setup(void) {
+    sha_gentables();
+    ed25519_gen();
+#ifdef NANO_SPEED
+    aes_gentables();
+#endif
+    crypto_sign_keypair(hpk, hsk);
+}
+
+int ssh_init(ssh_sess *s) {
+    memcpy(s->tx, V_S "\r\n", strlen(V_S) + 2);
+    s->txl = strlen(V_S) + 2;
+    s->after = SSH_ST_SERVICE;
+    return kex_init(s);
+}
+
+uint8_t *ssh_feed_buf(ssh_sess *s, size_t *room) {
+    if (s->rxo == s->rxl) {
+        s->rxo = s->rxl = 0;
+    } else if (s->rxo && SSH_RXBUF - s->rxl < SSH_PKT_MAX + 32) {
+        /* the partial packet at the tail might not fit: one move per read
+         * at most, never one per packet */
+        s->rxl -= s->rxo;
+        memmove(s->rx, s->rx + s->rxo, s->rxl);
+        s->rxo = 0;
+    }
+    *room = s->closing ? 0 : SSH_RXBUF - s->rxl;
+    return s->rx + s->rxl;
+}
+
+int ssh_feed_done(ssh_sess *s, size_t n) {
+    s->rxl += n;
+    return sess_input(s);
+}
+
+int ssh_feed(ssh_sess *s, const uint8_t *in, size_t n) {
+    while (n) {
+        size_t room;
+        uint8_t *b = ssh_feed_buf(s, &room);
+        if (!room) return s->closing ? 0 : -1;
+        if (room > n) room = n;
+        memcpy(b, in, room);
+        if (ssh_feed_done(s, room)) return -1;
+        in += room; n -= room;
+    }
+    return 0;
+}
+
+const uint8_t *ssh_drain(ssh_sess *s, size_t *n) {
+    *n = s->txl - s->txo;
+    s->txbusy = *n != 0;
+    return *n ? s->tx + s->txo : 0;
+}
+
+void ssh_drained(ssh_sess *s, size_t n) {
+    s->txbusy = 0;
+    s->txo += n;
+    if (s->txo == s->txl) s->txo = s->txl = 0;
+    sess_resume(s);                    /* output that waited for queue space */
+    if (kex_due(s)) kex_init(s);       /* no room: tried again next time */
+}
+
+/* ---- exec channels (see ssh.h) ---- */
+const char *ssh_chan_cmd(ssh_sess *s, unsigned ch) {
+    ssh_chan *c = &s->ch[ch];
+    if (c->run != 1) return 0;
+    c->run = 2;
+    return c->cmd;
+}
+
+uint8_t *ssh_chan_out(ssh_sess *s, unsigned ch, int ext, size_t *room) {
+    ssh_chan *c = &s->ch[ch];
+    size_t n = c->rwin;
+    uint8_t *d = 0;
+    if (n > c->rmax) n = c->rmax;
+    if (n > SSH_CHAN_PKT) n = SSH_CHAN_PKT;
+    if (c->eof < 2 && n && !held(s) &&
+        pkt_open(s, (ext ? 13 : 9) + n + PKT_SPARE))
+        d = s->tx + s->txl + PKT_HEAD;
+    *room = d ? n : 0;
+    return d ? d + (ext ? 13 : 9) : 0;
+}
+
+void ssh_chan_sent(ssh_sess *s, unsigned ch, int ext, size_t n) {
+    ssh_chan *c = &s->ch[ch];
+    uint8_t *d = s->tx + s->txl + PKT_HEAD;
+    size_t h = 9;
+    d[0] = MSG_CHANNEL_DATA;
+    PUT32(d + 1, c->rid);
+    if (ext) {
+        d[0] = MSG_CHANNEL_EXTENDED_DATA;
+        PUT32(d + 5, 1);                               /* SSH_EXTENDED_DATA_STDERR */
+        h = 13;
+    }
+    PUT32(d + h - 4, (uint32_t)n);
+    pkt_seal(s, h + n);
+    c->rwin -= (uint32_t)n;
+}
+
+const uint8_t *ssh_chan_in(ssh_sess *s, unsigned ch, size_t *n) {
+    ssh_chan *c = &s->ch[ch];
+    uint32_t r = c->inh & (SSH_CHAN_WIN - 1);
+    *n = c->inl;
+    if (*n > SSH_CHAN_WIN - r) *n = SSH_CHAN_WIN - r;  /* up to the wrap */
+    return *n ? s->inq[ch] + r : 0;
+}
+
+size_t ssh_chan_peek(ssh_sess *s, unsigned ch, size_t off, void *d, size_t n) {
+    ssh_chan *c = &s->ch[ch];
+    if (off >= c->inl) return 0;
+    if (n > c->inl - off) n = c->inl - off;
+    uint32_t r = (c->inh + (uint32_t)off) & (SSH_CHAN_WIN - 1), k = SSH_CHAN_WIN - r;
+    if (k > n) k = (uint32_t)n;
+    memcpy(d, s->inq[ch] + r, k);                      /* may wrap once */
+    memcpy((uint8_t *)d + k, s->inq[ch], n - k);
+    return n;
+}
+
+int ssh_chan_taken(ssh_sess *s, unsigned ch, size_t n) {
+    ssh_chan *c = &s->ch[ch];
+    c->inh += (uint32_t)n;
+    c->inl -= (uint32_t)n;
+    return chan_grant(s, c);
+}
+
+int ssh_chan_exit(ssh_sess *s, unsigned ch, int status) {
+    ssh_chan *c = &s->ch[ch];
+    c->run = 0;
+    c->inl = 0;                                        /* nobody reads it now */
+    c->hold = 0;
+    if (!c->eof) {
+        if (c->kind != SSH_CHAN_TCP && chan_exit_msg(s, c, status)) return -1;
+        c->eof = 1;
+    }
+    chan_flush(s, c);
+    return 0;
+}
+
+void ssh_chan_eof(ssh_sess *s, unsigned ch) {
+    ssh_chan *c = &s->ch[ch];
+    if (c->eof) return;
+    c->eof = c->hold = 1;
+    chan_flush(s, c);
+}
+
+int ssh_chan_confirm(ssh_sess *s, unsigned ch, int ok) {
+    ssh_chan *c = &s->ch[ch];
+    c->pend = 0;
+    if (!ok) c->used = c->run = 0;
+    return chan_reply(s, ch, c->rid, ok ? 0 : 2);      /* CONNECT_FAILED */
+}
@@ -0,0 +1,242 @@
+/* ssh.h - SSH server protocol engine with no I/O of its own.
+ *
+ * The whole server side of the protocol is an explicit state machine
+ *
+ *     VERSION -> KEXINIT -> ECDH -> NEWKEYS -> SERVICE -> USERAUTH
+ *             -> CHANNEL
+ *
+ * driven purely by bytes: the backend feeds whatever the client sent,
+ * drains whatever the session wants to send, and closes the transport once
+ * ssh_finished() says so. Nothing here blocks, sleeps or touches a file
+ * descriptor, so a blocking loop, epoll, io_uring or an MCU main loop can
+ * all drive it, with as many sessions per thread as memory allows and no
+ * stack per session.
+ *
+ * CHANNEL is the connection layer proper: up to SSH_MAX_CHAN session
+ * channels opened, used and closed in any order, so one handshake serves
+ * any number of commands (a ControlMaster, say), sftp sessions and
+ * direct-tcpip forwardings. The session only ends when the client
+ * disconnects.
+ *
+ * Keys are re-exchanged (RFC 4253 9) whenever the client asks and, from
+ * our side, after SSH_REKEY_BYTES either way or SSH_REKEY_SECS: a KEXINIT
+ * in SERVICE, USERAUTH or CHANNEL runs KEXINIT -> ECDH -> NEWKEYS again
+ * and returns to the step it interrupted. Channel output pauses for the
+ * round trip; nothing is torn down, so a session can run for days.
+ */
+#ifndef SSH_H
+#define SSH_H
+
+#include <stdint.h>
+#include "nolibc.h"
+#include "aes128_minimal.h"
+#include "sha256_minimal.h"
+#include "umac_minimal.h"
+#include "deflate.h"
+
+#define SSH_PORT 2222
+
+#define PUT32(b,v) do{uint32_t _v=(v);(b)[0]=_v>>24;(b)[1]=_v>>16;(b)[2]=_v>>8;(b)[3]=_v;}while(0)
+#define GET32(b) (((uint32_t)(b)[0]<<24)|((uint32_t)(b)[1]<<16)|((uint32_t)(b)[2]<<8)|(b)[3])
+
+/* Per-direction transport state */
+typedef struct {
+    aes128_ctr_ctx aes;
+    hmac_sha256_ctx mac;        /* keyed midstates, set at NEWKEYS */
+    umac_ctx umac;              /* or UMAC keys, if mlen < 32 */
+    uint8_t mlen;               /* MAC bytes: 8, 16 (UMAC) or 32 (HMAC) */
+    uint32_t seq;
+    int active;
+    uint64_t bytes;             /* sent / received under these keys */
+    uint8_t zlib;               /* zlib@openssh.com: once authenticated */
+    uint8_t etm;                /* MAC over length + ciphertext, length clear */
+} cstate_t;
+
+/* Protocol step: what the next client input must be. */
+enum { SSH_ST_VERSION, SSH_ST_KEXINIT, SSH_ST_ECDH, SSH_ST_NEWKEYS,
+       SSH_ST_SERVICE, SSH_ST_USERAUTH, SSH_ST_CHANNEL };
+
+#define SSH_PKT_MAX 35000           /* largest accepted packet_length + 4 */
+#define SSH_RXBUF (2 * SSH_PKT_MAX) /* always holds one packet + MAC */
+#define SSH_TXBUF (2 * SSH_PKT_MAX)
+#define SSH_CHAN_PKT 32768          /* max CHANNEL_DATA payload, both ways */
+#define SSH_CHAN_WIN (8 * SSH_CHAN_PKT)   /* receive window we grant:
+                                     * WINDOW_ADJUST refills it at half */
+#define SSH_CMD_MAX 1024            /* longest exec command */
+#define SSH_MAX_CHAN 10             /* channels open at once (sshd's
+                                     * MaxSessions default) */
+#define SSH_REKEY_BYTES (1ull << 30)  /* re-exchange after 1 GiB either way */
+#define SSH_REKEY_SECS 3600         /* ... or an hour under the same keys */
+#define SSH_KQ 4096                 /* messages held back meanwhile */
+
+/* What serves a channel: a command, the sftp subsystem, a TCP connection. */
+enum { SSH_CHAN_EXEC, SSH_CHAN_SFTP, SSH_CHAN_TCP };
+
+/* One session channel; our channel number is its index in ch[]. Output waits in out[0..outl) until the client's
+ * window lets it go, in CHANNEL_DATA packets of at most rmax bytes. */
+typedef struct {
+    uint32_t rid;               /* client's channel number */
+    uint32_t rwin, rmax;        /* client's window left / max packet */
+    uint32_t lwin;              /* what the client may still send us */
+    const uint8_t *out;         /* channel output not yet sent (not copied) */
+    size_t outl;
+    uint8_t eof;                /* 1: EOF + CLOSE due once out drains,
+                                 * 2: EOF sent, 3: CLOSE sent */
+    uint8_t run;                /* exec: 1 command to start, 2 started,
+                                 * 3 client closed while it runs */
+    uint8_t kind;               /* SSH_CHAN_EXEC, _SFTP (cmd is "sftp") or
+                                 * _TCP (cmd is the host to connect to) */
+    uint8_t pend;               /* open not confirmed yet */
+    uint8_t hold;               /* EOF only: CLOSE waits for ssh_chan_exit() */
+    uint16_t port;              /* _TCP */
+    uint8_t ieof;               /* client sent EOF or CLOSE */
+    uint8_t used;               /* slot open */
+    uint8_t rclose;             /* client sent CLOSE */
+    uint32_t inh, inl;          /* inq: read position (free-running), bytes */
+    char cmd[SSH_CMD_MAX];
+} ssh_chan;
+
+/* One session. Must start zero-filled (ssh_init() relies on it), so it can
+ * live in bss, on an mmap'd page or in a static pool. */
+typedef struct {
+    uint8_t st;
+    uint8_t hdr;                /* rx[rxo..rxo+16) already decrypted */
+    uint8_t closing;            /* finished once tx has drained */
+    uint8_t txbusy;             /* tx[txo..] handed out, must not move */
+    uint8_t kexing;             /* our KEXINIT sent, our NEWKEYS not yet */
+    uint8_t after;              /* step to resume once NEWKEYS is in */
+    uint8_t zneg;               /* zlib@openssh.com picked: 1 c2s, 2 s2c */
+    uint8_t mneg[2];            /* MAC picked (c2s, s2c): index in ours */
+    uint8_t authed;             /* USERAUTH_SUCCESS framed: compression on */
+    cstate_t c2s, s2c;
+    ssh_chan ch[SSH_MAX_CHAN];
+    /* handshake transcript, refilled by every key exchange */
+    int vl;
+    char cver[256];
+    size_t ckexl, skexl;
+    uint8_t ckex[SSH_PKT_MAX], skex[512];
+    uint8_t sid[32];            /* session id: the first exchange hash */
+    /* client->server keys, armed when the client's NEWKEYS arrives */
+    uint8_t kc[16], ivc[16], ikc[32];
+    long kt;                    /* clock (s) at the last key change */
+    uint64_t ktick;             /* bytes at which to read the clock again */
+    /* connection messages queued during a re-exchange, unencrypted:
+     * [len16][payload]..., sent from kq[kqo] on after our NEWKEYS */
+    size_t kqo, kql;
+    uint8_t kq[SSH_KQ];
+    size_t rxo, rxl;            /* rx[rxo..rxl): received, not yet parsed */
+    size_t txo, txl;
+    uint8_t rx[SSH_RXBUF], tx[SSH_TXBUF];
+    /* per channel, client data for an exec child's stdin, not yet taken.
+     * As large as the window we grant, so parsing never has to stop for a
+     * slow child: a WINDOW_ADJUST behind the data could otherwise deadlock
+     * a command that is blocked writing its output (or another channel).
+     * 256 KiB each, 2.5 MiB a session; pages are only touched as a channel
+     * actually receives data. */
+    uint8_t inq[SSH_MAX_CHAN][SSH_CHAN_WIN];
+    /* compression state, untouched unless the client asks for it */
+    zdef_t zd;
+    zinf_t zi;
+} ssh_sess;
+
+/* Once per process, before the first session: generate the hash/curve
+ * tables and the Ed25519 host key. */
+void ssh_setup(void);
+
+/* Start a session: queues the version banner and our KEXINIT. Returns -1
+ * if the transport should be dropped. */
+int ssh_init(ssh_sess *s);
+
+/* Input. ssh_feed_buf() returns where the next client bytes go and how
+ * many fit (zero-copy for a socket read); ssh_feed_done() then runs every
+ * packet that n more bytes completed. ssh_feed() is the copying form of
+ * the same pair. Both return -1 if the transport should be dropped. */
+uint8_t *ssh_feed_buf(ssh_sess *s, size_t *room);
+int ssh_feed_done(ssh_sess *s, size_t n);
+int ssh_feed(ssh_sess *s, const uint8_t *in, size_t n);
+
+/* Output. ssh_drain() returns the pending bytes (NULL, *n = 0 if none);
+ * ssh_drained() reports that the first n of them were written. The bytes
+ * stay in place until then, so an asynchronous send may own them. Channel
+ * output held back for lack of queue space is queued from ssh_drained(),
+ * so backends keep draining until ssh_drain() comes back empty.
+ *
+ * Output is corked: every packet (MAC included) is appended to one
+ * contiguous queue, and backends drain only after a whole feed has been
+ * processed. Banner + KEXINIT, KEX_ECDH_REPLY + NEWKEYS and DATA + EOF +
+ * CLOSE therefore leave in a single send() each. */
+const uint8_t *ssh_drain(ssh_sess *s, size_t *n);
+void ssh_drained(ssh_sess *s, size_t n);
+
+/* Exec channels, for a backend that can run processes. Every call names
+ * the channel, 0 .. SSH_MAX_CHAN-1; a backend keeps one child per index.
+ *
+ * ssh_chan_cmd() hands out the command of a new exec request once
+ * (NUL-terminated; NULL otherwise). The backend runs it and reports a
+ * failed start through ssh_chan_exit(). ssh_chan_kind() tells what to run:
+ * for SSH_CHAN_SFTP cmd is the subsystem name, for SSH_CHAN_TCP (a
+ * direct-tcpip forwarding) the host to connect to on ssh_chan_port().
+ * The client only learns of a forwarding channel from ssh_chan_confirm():
+ * ok once connected, else the channel is refused and gone.
+ *
+ * Child output goes straight into the next packet: ssh_chan_out() returns
+ * where up to *room bytes of stdout (ext 0) or stderr (ext 1) may be read,
+ * and ssh_chan_sent() then queues the n bytes read there as CHANNEL_DATA or
+ * EXTENDED_DATA; nothing else may be queued in between. *room is 0 while
+ * the client's window or the output queue is full: leave the pipe alone
+ * until the next feed or drain. The queue holds about two full packets, so
+ * a backend that reads one packet per channel per readiness event shares
+ * it round-robin: a bulk transfer cannot starve an interactive channel.
+ *
+ * ssh_chan_in() returns queued client data for the child's stdin (NULL,
+ * *n = 0 if none) and ssh_chan_taken() consumes n bytes of it; the window
+ * reopens only as the child takes it, so a slow child pushes back on the
+ * client. ssh_chan_peek() copies up to n queued bytes from off bytes past
+ * the head without taking them, for a consumer that parses messages out
+ * of the queue. ssh_chan_ieof() is true once the client sent EOF and
+ * everything before it was taken. ssh_chan_gone() is true once the client
+ * closed the channel under a running child: kill it, then ssh_chan_exit().
+ *
+ * ssh_chan_exit() takes the wait(2) status once the child is reaped and its
+ * output read to EOF: exit-status or exit-signal, then EOF and CLOSE (a
+ * forwarding has no status). ssh_chan_eof() sends just the EOF, for
+ * output that ends while input still flows; CLOSE then waits for
+ * ssh_chan_exit(). ssh_chan_taken(), ssh_chan_exit() and
+ * ssh_chan_confirm() return -1 if the transport should be dropped. */
+const char *ssh_chan_cmd(ssh_sess *s, unsigned ch);
+uint8_t *ssh_chan_out(ssh_sess *s, unsigned ch, int ext, size_t *room);
+void ssh_chan_sent(ssh_sess *s, unsigned ch, int ext, size_t n);
+const uint8_t *ssh_chan_in(ssh_sess *s, unsigned ch, size_t *n);
+size_t ssh_chan_peek(ssh_sess *s, unsigned ch, size_t off, void *d, size_t n);
+int ssh_chan_taken(ssh_sess *s, unsigned ch, size_t n);
+int ssh_chan_exit(ssh_sess *s, unsigned ch, int status);
+void ssh_chan_eof(ssh_sess *s, unsigned ch);
+int ssh_chan_confirm(ssh_sess *s, unsigned ch, int ok);
+
+static inline int ssh_chan_ieof(const ssh_sess *s, unsigned ch)
+{
+    return s->ch[ch].ieof && !s->ch[ch].inl;
+}
+
+static inline int ssh_chan_kind(const ssh_sess *s, unsigned ch)
+{
+    return s->ch[ch].kind;
+}
+
+static inline int ssh_chan_port(const ssh_sess *s, unsigned ch)
+{
+    return s->ch[ch].port;
+}
+
+static inline int ssh_chan_gone(const ssh_sess *s, unsigned ch)
+{
+    return s->ch[ch].run == 3;
+}
+
+/* Non-zero once the session is over and all its output has drained. */
+static inline int ssh_finished(const ssh_sess *s)
+{
+    return s->closing && s->txo == s->txl;
+}
+
+#endif /* SSH_H */
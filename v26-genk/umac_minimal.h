@@ -0,0 +1,185 @@
+/*
+ * Minimal UMAC (RFC 4418), as OpenSSH's umac-64 / umac-128
+ * Built on the AES-128 of aes128_minimal.h
+ *
+ * Implements:
+ * - Key setup (AES-based key derivation, once per NEWKEYS)
+ * - UHASH: NH over 1 KB chunks, POLY mod 2^64 - 59 above 1 KB, then the
+ *   inner product mod 2^36 - 5, 2 or 4 streams
+ * - The pad: AES of the nonce, one block per two packets for umac-64
+ *
+ * Messages are taken whole, as SSH MACs one packet at a time; OpenSSH's
+ * 2^14-byte limit on the 64-bit POLY key holds for any SSH packet.
+ */
+
+#ifndef UMAC_MINIMAL_H
+#define UMAC_MINIMAL_H
+
+#include <stdint.h>
+#include "nolibc.h"
+#include "aes128_minimal.h"
+
+#define UMAC_L1 1024                    /* NH chunk, bytes */
+#define UMAC_P36 0x0000000FFFFFFFFBull  /* 2^36 - 5 */
+#define UMAC_P64 0xFFFFFFFFFFFFFFC5ull  /* 2^64 - 59 */
+
+typedef struct {
+    uint32_t nh[UMAC_L1 / 4 + 12];      /* L1 key, 4 words more per stream */
+    uint64_t poly[4];                   /* L2 keys */
+    uint64_t ip[16];                    /* L3 keys, mod 2^36 - 5 */
+    uint32_t trans[4];
+    aes128_ctr_ctx pdf;                 /* pad key */
+    uint8_t pad[16], pn[8];             /* last pad and its nonce */
+    int streams;                        /* 2: umac-64, 4: umac-128 */
+} umac_ctx;
+
+/* One AES block: CTR over zeros with the input as the counter serves
+ * every backend (byte-wise, bitsliced, AES-NI) alike. */
+static inline void umac_aes(aes128_ctr_ctx *k, const uint8_t *in,
+                            uint8_t *out) {
+    memcpy(k->counter, in, 16);
+    memset(out, 0, 16);
+    aes128_ctr_crypt(k, out, 16);
+}
+
+/* KDF: AES(index || i) for i = 1, 2, ... as 64-bit big-endian words */
+static inline void umac_kdf(aes128_ctr_ctx *k, uint8_t ndx, uint8_t *out,
+                            size_t n) {
+    uint8_t in[16] = {0}, b[16];
+    in[7] = ndx;
+    for (uint8_t i = 1; n; i++) {
+        size_t l = n < 16 ? n : 16;
+        in[15] = i;
+        umac_aes(k, in, b);
+        memcpy(out, b, l);
+        out += l; n -= l;
+    }
+}
+
+static inline uint32_t umac_be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+           (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline uint64_t umac_be64(const uint8_t *p) {
+    return (uint64_t)umac_be32(p) << 32 | umac_be32(p + 4);
+}
+
+static inline void umac_init(umac_ctx *u, const uint8_t *key, int taglen) {
+    static const uint8_t zero[16];
+    aes128_ctr_ctx k;
+    uint8_t b[256];
+    int s = u->streams = taglen / 4;
+    aes128_ctr_init(&k, key, zero);
+
+    umac_kdf(&k, 0, b, 16);
+    aes128_ctr_init(&u->pdf, b, zero);
+    memset(u->pn, 0xff, 8);             /* no nonce has a pad yet */
+
+    int nw = UMAC_L1 / 4 + 4 * (s - 1);
+    umac_kdf(&k, 1, (uint8_t *)u->nh, 4 * (size_t)nw);
+    for (int i = 0; i < nw; i++) {
+        uint8_t *p = (uint8_t *)(u->nh + i);
+        u->nh[i] = umac_be32(p);
+    }
+
+    umac_kdf(&k, 2, b, 24 * (size_t)s);
+    for (int i = 0; i < s; i++)
+        u->poly[i] = umac_be64(b + 24 * i) & 0x01ffffff01ffffffull;
+
+    umac_kdf(&k, 3, b, 64 * (size_t)s);
+    for (int i = 0; i < 4 * s; i++)
+        u->ip[i] = umac_be64(b + 32 + 64 * (i / 4) + 8 * (i % 4)) % UMAC_P36;
+
+    umac_kdf(&k, 4, b, 4 * (size_t)s);
+    for (int i = 0; i < s; i++) u->trans[i] = umac_be32(b + 4 * i);
+}
+
+/* NH over nb 32-byte blocks, per stream; ns is a constant after inlining */
+static inline __attribute__((always_inline))
+void umac_nh_blocks(const uint32_t *k, const uint8_t *m, size_t nb,
+                    uint64_t *h, int ns) {
+    for (size_t j = 0; j < nb; j++, m += 32, k += 8) {
+        uint32_t d[8];
+        for (int w = 0; w < 8; w++) {        /* little-endian words */
+            const uint8_t *p = m + 4 * w;
+            d[w] = (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+                   (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        }
+        for (int i = 0; i < ns; i++)
+            for (int w = 0; w < 4; w++)
+                h[i] += (uint64_t)(uint32_t)(k[4 * i + w] + d[w]) *
+                        (uint32_t)(k[4 * i + w + 4] + d[w + 4]);
+    }
+}
+
+/* L1: NH of one chunk (zero-padded to 32 bytes, at least one block) plus
+ * its length in bits, per stream */
+static inline void umac_nh(const umac_ctx *u, const uint8_t *m, size_t len,
+                           uint64_t *h) {
+    uint8_t last[32] = {0};
+    size_t full = len / 32;
+    for (int i = 0; i < u->streams; i++) h[i] = 8 * (uint64_t)len;
+    if (u->streams == 2) umac_nh_blocks(u->nh, m, full, h, 2);
+    else umac_nh_blocks(u->nh, m, full, h, 4);
+    if (len % 32 || !len) {
+        memcpy(last, m + 32 * full, len % 32);
+        if (u->streams == 2) umac_nh_blocks(u->nh + 8 * full, last, 1, h, 2);
+        else umac_nh_blocks(u->nh + 8 * full, last, 1, h, 4);
+    }
+}
+
+/* L2 step: (a * k + m) mod 2^64 - 59 */
+static inline uint64_t umac_poly(uint64_t a, uint64_t k, uint64_t m) {
+    unsigned __int128 x = (unsigned __int128)a * k + m;
+    uint64_t r = (uint64_t)x, c = (uint64_t)(x >> 64);
+    while (c) {                         /* 2^64 = 59 */
+        x = (unsigned __int128)c * 59 + r;
+        r = (uint64_t)x; c = (uint64_t)(x >> 64);
+    }
+    return r >= UMAC_P64 ? r - UMAC_P64 : r;
+}
+
+/* Tag of len bytes at m under the 8-byte nonce: 4 * streams bytes */
+static inline void umac_compute(umac_ctx *u, uint8_t *tag,
+                                const uint8_t *nonce, const uint8_t *m,
+                                size_t len) {
+    uint64_t y[4], h[4];
+    if (len <= UMAC_L1) {
+        umac_nh(u, m, len, y);
+    } else {
+        for (int i = 0; i < u->streams; i++) y[i] = 1;
+        for (size_t o = 0; o < len; o += UMAC_L1) {
+            umac_nh(u, m + o, len - o < UMAC_L1 ? len - o : UMAC_L1, h);
+            for (int i = 0; i < u->streams; i++) {
+                if (h[i] >> 32 == 0xffffffffu) {  /* out of the word range */
+                    y[i] = umac_poly(y[i], u->poly[i], UMAC_P64 - 1);
+                    h[i] -= 59;
+                }
+                y[i] = umac_poly(y[i], u->poly[i], h[i]);
+            }
+        }
+    }
+
+    /* L3, and the pad: umac-64 takes half a block, by the nonce's low bit */
+    uint8_t n[16] = {0};
+    int half = u->streams == 2 ? nonce[7] & 1 : 0;
+    memcpy(n, nonce, 8);
+    if (u->streams == 2) n[7] &= 0xfe;
+    if (memcmp(n, u->pn, 8)) {
+        umac_aes(&u->pdf, n, u->pad);
+        memcpy(u->pn, n, 8);
+    }
+    for (int i = 0; i < u->streams; i++) {
+        uint64_t t = 0;
+        for (int j = 0; j < 4; j++)
+            t += u->ip[4 * i + j] * (uint16_t)(y[i] >> (48 - 16 * j));
+        t = (t & 0xFFFFFFFFFull) + 5 * (t >> 36);
+        if (t >= UMAC_P36) t -= UMAC_P36;
+        uint32_t v = (uint32_t)t ^ u->trans[i];
+        for (int j = 0; j < 4; j++) tag[4 * i + j] = (uint8_t)(v >> (24 - 8 * j));
+    }
+    for (int i = 0; i < 4 * u->streams; i++) tag[i] ^= u->pad[8 * half + i];
+}
+
+#endif /* UMAC_MINIMAL_H */